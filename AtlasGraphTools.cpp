@@ -1,5 +1,17 @@
 #include "AtlasGraphTools.hpp"
 
+#ifdef ATLAS_TRACE
+#include <map>
+#include <string>
+#include <string.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
 /***********************************************************
  ************************************************************
  ** Constructor for Node Type without parent graph.
@@ -16,14 +28,36 @@ Node::Node(float x, float y)
     this->neighbors = new PriorityQueue(this);
     this->pathLength = INFINITY;
     this->neighborsHeuristic = (PriorityQueue*)NULL;
+    this->previous = (Node*)NULL;
+    this->deleted = 0;
+    this->directed = 0;
+    this->componentParent = this;
+    this->componentRank = 0;
+    this->componentStale = 0;
 }
 
+/***********************************************************
+ ************************************************************
+ ** Destructor for Node Type
+ ** Frees the neighbor queues owned by the node
+ ** Neighbors still pointing at this node are not updated;
+ ** detach the node first (Graph::removeNode)
+ ************************************************************
+ ************************************************************/
+
+Node::~Node()
+{
+    delete this->neighbors;
+    delete this->neighborsHeuristic;
+}
 
 /***********************************************************
  ************************************************************
  ** Function to add a neighbor to a node
  ** A neighbor is defined as a node that
  ** can be reached from this node
+ ** The connection goes both ways unless this node belongs
+ ** to a directed graph
  ** Argument is the node to be added and distance to neightbor
  ** Special Return Codes:
  **       -2: Indicated nodes are already neighbors
@@ -42,13 +76,147 @@ int Node::addNeighbor(Node *neighbor)
     }
 
     int rc1 = this->neighbors->insert(neighbor, 0);
-    int rc2 = neighbor->neighbors->insert(this, 0);
     this->neighborCount++;
+    this->unionComponent(neighbor);
+    if (this->directed) {
+        return rc1;
+    }
+    int rc2 = neighbor->neighbors->insert(this, 0);
     neighbor->neighborCount++;
     return (rc1&rc2);
 
 }
 
+/***********************************************************
+ ************************************************************
+ ** Function to find the root of a nodes component
+ ** Halves the path to the root on the way, so it must only
+ ** be called by writers (addNeighbor)
+ ************************************************************
+ ************************************************************/
+
+Node *Node::compressComponent()
+{
+    Node *node = this;
+    while (node->componentParent != node) {
+        node->componentParent = node->componentParent->componentParent;
+        node = node->componentParent;
+    }
+    return node;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to merge the components of two nodes
+ ** Union by rank; a merged component is stale if either
+ ** part was
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Node::unionComponent(Node *node)
+{
+    Node *root1 = this->compressComponent();
+    Node *root2 = node->compressComponent();
+    if (root1 == root2) {
+        return SUCCESS;
+    }
+    if (root1->componentRank < root2->componentRank) {
+        Node *swap = root1;
+        root1 = root2;
+        root2 = swap;
+    }
+    root2->componentParent = root1;
+    root1->componentStale |= root2->componentStale;
+    if (root1->componentRank == root2->componentRank) {
+        root1->componentRank++;
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the representative of a nodes component
+ ** Read only, so it is safe during concurrent searches
+ ** Nodes with the same representative are connected
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+Node *Node::getComponent() const
+{
+    const Node *node = this;
+    while (node->componentParent != node) {
+        node = node->componentParent;
+    }
+    return (Node *)node;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to check the connectivity index for a path
+ ** Returns 0 only when no path can exist between the nodes;
+ ** 1 means they may be connected. Removing an edge marks its
+ ** component stale, and stale components always answer 1
+ ** until Graph::rebuildComponents relabels them
+ ** Argument is the node to be reached
+ ************************************************************
+ ************************************************************/
+
+int Node::mayReach(Node *node) const
+{
+    if (node == (Node *)NULL)
+    {
+        return NULL_ARG;
+    }
+    Node *root1 = this->getComponent();
+    Node *root2 = node->getComponent();
+    return (root1 == root2 || root1->componentStale || root2->componentStale);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to remove a neighbor from a node
+ ** Both directions of the connection are tombstoned, or
+ ** only this one if this node belongs to a directed graph;
+ ** a neighbor list is compacted once more than half of its
+ ** entries are tombstones, so lists stay dense
+ ** Argument is the node to be removed
+ ** Special Return Codes:
+ **       -1: Indicates nodes are not neighbors
+ ************************************************************
+ ************************************************************/
+
+int Node::removeNeighbor(Node *neighbor)
+{
+    if (neighbor == (Node *)NULL)
+    {
+        return NULL_ARG;
+    }
+
+    if (!this->isNeighbor(neighbor)) {
+        return -1;
+    }
+
+    int rc1 = this->neighbors->tombstone(neighbor);
+    this->neighborCount--;
+    this->getComponent()->componentStale = 1; // The component may have split
+    if (2 * this->neighbors->getTombstoneCount() > this->neighbors->getNodeCount()) {
+        this->neighbors->compact();
+    }
+    if (this->directed) {
+        return rc1; // The opposite one-way edge, if any, stays
+    }
+
+    if (neighbor->neighbors->tombstone(this) == SUCCESS) {
+        neighbor->neighborCount--;
+    }
+    if (2 * neighbor->neighbors->getTombstoneCount() > neighbor->neighbors->getNodeCount()) {
+        neighbor->neighbors->compact();
+    }
+    return rc1;
+}
+
 /***********************************************************
 ************************************************************
 ** Function to get neighbor nodes sorted by
@@ -67,7 +235,9 @@ PriorityQueue* Node::getNeighbors(Node* goalNode) {
     PriorityQueue *queue = new PriorityQueue(goalNode);
     int i;
     for (i = 0; i < this->getNeighbors()->getNodeCount(); i++) {
-
+        if (this->neighbors->getNodeAtIndex(i) == (Node*)NULL || this->neighbors->getNodeAtIndex(i)->deleted) {
+            continue; // Removed neighbor, or a one-way edge into a removed node
+        }
         queue->insert(this->neighbors->getNodeAtIndex(i), this->pathLength + getNodeDistance(this, this->neighbors->getNodeAtIndex(i)));
     }
     return queue;
@@ -139,6 +309,7 @@ int Node::isNeighbor(Node *node)
 PriorityQueue::PriorityQueue(Node *goalNode) {
     this->goalNode = goalNode;
     this->count = 0;
+    this->tombstoneCount = 0;
 }
 
 /***********************************************************
@@ -222,6 +393,24 @@ int PriorityQueue::insert(Node *node, float pathLength)
 
     float remainingDistance = getNodeDistance(node, this->goalNode);
     float newHeuristic = (SHORTEST_PATH_BIAS * pathLength) + (CLOSEST_NODE_BIAS * remainingDistance);
+    return this->insertWithHeuristic(node, newHeuristic);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function implementation for Insert with a heuristic
+ ** computed by the caller
+ ** Takes node to be added into queue and its heuristic
+ ** Returns -2 if the node is already in the queue in a better path
+ ************************************************************
+ ************************************************************/
+
+int PriorityQueue::insertWithHeuristic(Node *node, float newHeuristic)
+{
+    if (node == (Node *)NULL) //Check for null input argument
+    {
+        return NULL_ARG;
+    }
 
     //
     // Check and see if the node exists in the queue
@@ -288,6 +477,9 @@ int PriorityQueue::removeNode(int index) {
     if (index >= count) {
         return OUT_OF_BOUNDS;
     }
+    if (this->nodes[index] == (Node*)NULL) {
+        this->tombstoneCount--;
+    }
     for (; index + 1 < count; index++) {
         this->nodes[index] = this->nodes[index+1];
         this->heuristics[index] = this->heuristics[index+1];
@@ -315,6 +507,56 @@ int PriorityQueue::removeNode(Node* node) {
     return this->removeNode(index);
 }
 
+/***********************************************************
+************************************************************
+** Function implementation for Tombstone of a PriorityQueue
+** Clears the entry of a node without shifting the queue
+** Takes the node to be removed
+** Returns -1 if the node is not in the array
+************************************************************
+************************************************************/
+
+int PriorityQueue::tombstone(Node* node) {
+    if (node == (Node*) NULL) {
+        return NULL_ARG;
+    }
+    int index = this->getNodeIndex(node);
+    if (index == -1) {
+        return -1;
+    }
+    this->nodes[index] = (Node*)NULL;
+    this->tombstoneCount++;
+    return SUCCESS;
+}
+
+/***********************************************************
+************************************************************
+** Function implementation for Compact of a PriorityQueue
+** Squeezes out tombstoned entries, keeping the order of
+** the remaining entries, and releases the spare capacity
+** No speical return codes
+************************************************************
+************************************************************/
+
+int PriorityQueue::compact() {
+    int index;
+    int liveIndex = 0;
+    for (index = 0; index < this->count; index++) {
+        if (this->nodes[index] != (Node*)NULL) {
+            this->nodes[liveIndex] = this->nodes[index];
+            this->heuristics[liveIndex] = this->heuristics[index];
+            liveIndex++;
+        }
+    }
+    this->count = liveIndex;
+    this->tombstoneCount = 0;
+    this->nodes.resize(this->count);
+    this->heuristics.resize(this->count);
+    this->nodes.shrink_to_fit();
+    this->heuristics.shrink_to_fit();
+    return SUCCESS;
+}
+
 /***********************************************************
 ************************************************************
 ** Function implementation for GetMin of a PriorityQueue
@@ -323,6 +565,10 @@ int PriorityQueue::removeNode(Node* node) {
 ************************************************************/
 
 Node* PriorityQueue::getMin() {
+    while (this->count > 0 && this->nodes[this->count-1] == (Node*)NULL) {
+        this->count--; // Drop trailing tombstones
+        this->tombstoneCount--;
+    }
     if (this->count == 0) {
         return (Node*)OUT_OF_BOUNDS;
     }
@@ -337,10 +583,10 @@ Node* PriorityQueue::getMin() {
 ************************************************************/
 
 Node* PriorityQueue::pop() {
-    if (this->count == 0) {
-        return (Node*)OUT_OF_BOUNDS;
-    }
     Node* retNode = this->getMin();
+    if (retNode == (Node*)OUT_OF_BOUNDS) {
+        return retNode;
+    }
     this->count--;
     return retNode;
 }
@@ -349,21 +595,32 @@ Node* PriorityQueue::pop() {
 ************************************************************
 ** Function implementation for AStar
 **  Arguments are starting node and path queue
+**  The path is left in the previous links of the nodes;
+**  links from an earlier search are cleared first, since
+**  removals can make a once reachable goal unreachable
 ** Returns a -1 if a path does not exist between nodes
 ************************************************************
 ************************************************************/
 
 int AStar(Node* startNode, Node* goalNode) {
+    ATLAS_TRACE_SCOPE("AStar");
     if (startNode == (Node*)NULL || goalNode == (Node*)NULL) {
         return NULL_ARG;
     }
+    goalNode->previous = (Node*)NULL;
+    goalNode->pathLength = INFINITY;
+    startNode->previous = (Node*)NULL;
+    if (!startNode->mayReach(goalNode)) {
+        return -1;
+    }
     PriorityQueue *queue = new PriorityQueue(goalNode);
     startNode->pathLength = 0;
     queue->insert(startNode, 0);
     float rc;
-    int i, deadPath;
+    int i, deadPath, deadEnd;
     deadPath = 0;
     while (deadPath == 0) {
+        ATLAS_TRACE_SAMPLE();
         for (i = 0; i < queue->getNodeCount(); i++) {
             if (queue->getHeuristicAtIndex(i) != INFINITY) {
                 deadPath = 0;
@@ -378,18 +635,32 @@ int AStar(Node* startNode, Node* goalNode) {
             break;
         }
         Node* currentNode = queue->getMin();
-        if (currentNode->neighborsHeuristic == (PriorityQueue*)NULL) {
-            currentNode->neighborsHeuristic = currentNode->getNeighbors(goalNode);
+
+        //
+        // Expand the next neighbor, then score and queue it;
+        // the same phases as the snapshot search so traces of
+        // both can be compared
+        //
+
+        Node* nextNode = (Node*)NULL;
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::expand");
+            if (currentNode->neighborsHeuristic == (PriorityQueue*)NULL) {
+                currentNode->neighborsHeuristic = currentNode->getNeighbors(goalNode);
+            }
+            deadEnd = (currentNode->neighborsHeuristic->getNodeCount() == 0);
+            if (!deadEnd) {
+                nextNode = currentNode->neighborsHeuristic->pop();
+            }
         }
-        if (currentNode->neighborsHeuristic->getNodeCount() == 0) {
+        if (deadEnd) {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::queue");
             queue->removeNode(currentNode);
             currentNode->pathLength = INFINITY;
             queue->insert(currentNode, INFINITY);
             continue;
         }
 
-        Node* nextNode = currentNode->neighborsHeuristic->pop();
-
         if (nextNode == goalNode) {
             goalNode->previous = currentNode;
             std::cout << "I AM HERE" << std::endl;
@@ -397,15 +668,23 @@ int AStar(Node* startNode, Node* goalNode) {
             //return SUCCESS;
         }
 
-        rc = queue->insert(nextNode, currentNode->pathLength + getNodeDistance(currentNode, nextNode));
-        if (rc == -2) {
-            queue->removeNode(currentNode);
-            currentNode->pathLength = INFINITY;
-            queue->insert(currentNode, INFINITY);
+        float nextLength;
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::heuristic");
+            nextLength = currentNode->pathLength + getNodeDistance(currentNode, nextNode);
         }
-        else if (rc == SUCCESS) {
-            nextNode->pathLength = currentNode->pathLength + getNodeDistance(currentNode, nextNode);
-            nextNode->previous = currentNode;
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::queue");
+            rc = queue->insert(nextNode, nextLength);
+            if (rc == -2) {
+                queue->removeNode(currentNode);
+                currentNode->pathLength = INFINITY;
+                queue->insert(currentNode, INFINITY);
+            }
+            else if (rc == SUCCESS) {
+                nextNode->pathLength = nextLength;
+                nextNode->previous = currentNode;
+            }
         }
     }
     std::cout << "H" << std::endl;
@@ -415,6 +694,10 @@ int AStar(Node* startNode, Node* goalNode) {
             std::cout << "(" << queue->getNodeAtIndex(i)->getLocation().x << "," << queue->getNodeAtIndex(i)->getLocation().y << ")" << std::endl;
         }
         queue->getNodeAtIndex(i)->resetNeighbors();
+        if (goalNode->previous == (Node*)NULL) {
+            queue->getNodeAtIndex(i)->previous = (Node*)NULL; // No path to leave behind
+            queue->getNodeAtIndex(i)->pathLength = INFINITY;
+        }
     }
 
     if (goalNode->previous != (Node*)NULL) {
@@ -423,4 +706,3166 @@ int AStar(Node* startNode, Node* goalNode) {
 
     return -1;
 }
+
+/***********************************************************
+************************************************************
+** Function implementation for AStar on a GraphSnapshot
+**  Arguments are starting node, goal node, the snapshot
+**  supplying edge costs and an optional output path
+**  A NULL snapshot searches with plain edge lengths
+**  Search state is kept local to the call and nodes are
+**  never modified, so concurrent searches are safe as long
+**  as the node adjacency is not being changed
+** Returns a -1 if a path does not exist between nodes
+************************************************************
+************************************************************/
+
+int AStar(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path) {
+    return AStar(startNode, goalNode, snapshot, path, (PathCache*)NULL, (SearchControl*)NULL);
+}
+
+/***********************************************************
+************************************************************
+** Search loop shared by the snapshot AStar functions
+**  The control, when given, is polled once per expanded node
+************************************************************
+************************************************************/
+
+static int searchSnapshot(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path, SearchControl* control) {
+    ATLAS_TRACE_SCOPE("AStar");
+    if (path != (std::vector<Node*>*)NULL) {
+        path->clear();
+    }
+    if (control != (SearchControl*)NULL) {
+        int rc = control->begin();
+        if (rc != SUCCESS) {
+            return rc;
+        }
+    }
+    if (!startNode->mayReach(goalNode)) {
+        return -1; // Closed edges only ever disconnect nodes further
+    }
+
+    PriorityQueue queue(goalNode);
+    std::unordered_map<Node*, float> pathLengths;
+    std::unordered_map<Node*, Node*> previous;
+    std::vector<std::pair<Node*, float> > improved; // Neighbors reached by a shorter path
+    size_t i;
+
+    pathLengths[startNode] = 0;
+    queue.insert(startNode, 0);
+
+    while (queue.getNodeCount() > 0) {
+        ATLAS_TRACE_SAMPLE();
+        if (control != (SearchControl*)NULL) {
+            int rc = control->expand();
+            if (rc != SUCCESS) {
+                if (path != (std::vector<Node*>*)NULL) {
+                    path->clear();
+                }
+                return rc;
+            }
+        }
+        Node* currentNode = queue.pop(); // O(1), the queue keeps its minimum last
+
+        if (currentNode == goalNode) {
+            if (path != (std::vector<Node*>*)NULL) {
+                Node* pathNode = goalNode;
+                while (pathNode != startNode) {
+                    path->push_back(pathNode);
+                    pathNode = previous[pathNode];
+                }
+                path->push_back(startNode);
+                std::reverse(path->begin(), path->end());
+            }
+            return SUCCESS;
+        }
+
+        //
+        // Expand the neighbors, then score and queue the ones
+        // reached by a shorter path; separate phases so each
+        // can be traced
+        //
+
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::expand");
+            float currentLength = pathLengths[currentNode];
+            PriorityQueue* neighbors = currentNode->getNeighbors();
+            int j;
+            improved.clear();
+            for (j = 0; j < neighbors->getNodeCount(); j++) {
+                Node* nextNode = neighbors->getNodeAtIndex(j);
+                if (nextNode == (Node*)NULL || nextNode->isDeleted()) {
+                    continue; // Removed neighbor, or a one-way edge into a removed node
+                }
+                float cost;
+                if (snapshot != (const GraphSnapshot*)NULL) {
+                    cost = snapshot->getEdgeCost(currentNode, nextNode);
+                }
+                else {
+                    cost = getNodeDistance(currentNode, nextNode);
+                }
+                if (cost == INFINITY) {
+                    continue; // Edge is closed in this snapshot
+                }
+
+                float nextLength = currentLength + cost;
+                std::unordered_map<Node*, float>::iterator known = pathLengths.find(nextNode);
+                if (known != pathLengths.end() && known->second <= nextLength) {
+                    continue;
+                }
+                pathLengths[nextNode] = nextLength;
+                previous[nextNode] = currentNode;
+                improved.push_back(std::pair<Node*, float>(nextNode, nextLength));
+            }
+        }
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::heuristic");
+            for (i = 0; i < improved.size(); i++) {
+                improved[i].second = (SHORTEST_PATH_BIAS * improved[i].second) +
+                                     (CLOSEST_NODE_BIAS * getNodeDistance(improved[i].first, goalNode));
+            }
+        }
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::queue");
+            for (i = 0; i < improved.size(); i++) {
+                queue.insertWithHeuristic(improved[i].first, improved[i].second);
+            }
+        }
+    }
+
+    return -1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructors for GraphSnapshot Type
+ ** Arguments are the version number of the snapshot and
+ ** optionally the overrides it shares with other versions
+ ************************************************************
+ ************************************************************/
+
+GraphSnapshot::GraphSnapshot(unsigned long version) {
+    this->version = version;
+    this->edgeCosts = std::make_shared<const edge_cost_map_t>();
+}
+
+GraphSnapshot::GraphSnapshot(unsigned long version, std::shared_ptr<const edge_cost_map_t> edgeCosts) {
+    this->version = version;
+    this->edgeCosts = edgeCosts;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to build the overlay key of an edge
+ ** Both orientations of an undirected edge map to the same
+ ** key; the edges of a directed graph are keyed one way
+ ************************************************************
+ ************************************************************/
+
+GraphSnapshot::edge_key_t GraphSnapshot::makeKey(Node *node1, Node *node2) {
+    if (!node1->isDirected() && std::less<Node*>()(node2, node1)) {
+        return edge_key_t(node2, node1);
+    }
+    return edge_key_t(node1, node2);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the cost of an edge in this snapshot
+ ** Argument is the two nodes of the edge
+ ** Edges without an override cost their length
+ ** Special Return Codes:
+ **       INFINITY: Indicates the edge is closed
+ ************************************************************
+ ************************************************************/
+
+float GraphSnapshot::getEdgeCost(Node *node1, Node *node2) const {
+    if (node1 == (Node *)NULL || node2 == (Node *)NULL)
+    {
+        return NULL_ARG;
+    }
+    if (!this->edgeCosts->empty()) {
+        edge_cost_map_t::const_iterator edgeCost = this->edgeCosts->find(makeKey(node1, node2));
+        if (edgeCost != this->edgeCosts->end()) {
+            return edgeCost->second;
+        }
+    }
+    return getNodeDistance(node1, node2);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to queue a new cost for an edge
+ ** Arguments are the two nodes of the edge and the cost
+ ** In a directed graph only the edge from node1 to node2
+ ** is changed
+ ** Costs below the edge length make the A* heuristic
+ ** inadmissible and may produce longer paths
+ ** Special Return Codes:
+ **       -1: Indicates the nodes are not neighbors
+ **       -2: Indicates a negative or NaN cost
+ ************************************************************
+ ************************************************************/
+
+int EdgeUpdateBatch::setEdgeCost(Node *node1, Node *node2, float cost) {
+    if (node1 == (Node *)NULL || node2 == (Node *)NULL)
+    {
+        return NULL_ARG;
+    }
+    if (!node1->isNeighbor(node2)) {
+        return -1;
+    }
+    if (!(cost >= 0)) { // Also rejects NaN
+        return -2;
+    }
+    edge_update_t update;
+    update.node1 = node1;
+    update.node2 = node2;
+    update.cost = cost;
+    update.reset = 0;
+    this->updates.push_back(update);
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to queue the closing of an edge
+ ** A closed edge is skipped by searches on the snapshot
+ ** Special Return Codes:
+ **       -1: Indicates the nodes are not neighbors
+ ************************************************************
+ ************************************************************/
+
+int EdgeUpdateBatch::closeEdge(Node *node1, Node *node2) {
+    return this->setEdgeCost(node1, node2, INFINITY);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to queue the removal of an edge cost override
+ ** The edge goes back to costing its length
+ ** Special Return Codes:
+ **       -1: Indicates the nodes are not neighbors
+ ************************************************************
+ ************************************************************/
+
+int EdgeUpdateBatch::resetEdgeCost(Node *node1, Node *node2) {
+    int rc = this->setEdgeCost(node1, node2, 0);
+    if (rc == SUCCESS) {
+        this->updates.back().reset = 1;
+    }
+    return rc;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to discard all queued updates
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int EdgeUpdateBatch::clear() {
+    this->updates.clear();
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructor for Graph Type
+ ** The graph starts at version 0 with no overrides
+ ************************************************************
+ ************************************************************/
+
+Graph::Graph() {
+    this->deletedCount = 0;
+    this->directed = 0;
+    this->componentsStale = 0;
+    this->structureVersion = 0;
+    this->searchCount = 0;
+    this->editCount = 0;
+    this->editing = 0;
+    std::atomic_store(&this->snapshot, std::shared_ptr<const GraphSnapshot>(new GraphSnapshot(0)));
+}
+
+/***********************************************************
+ ************************************************************
+ ** Destructor for Graph Type
+ ** Frees every node owned by the graph
+ ************************************************************
+ ************************************************************/
+
+Graph::~Graph() {
+    size_t i;
+    for (i = 0; i < this->nodes.size(); i++) {
+        delete this->nodes[i];
+    }
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to add a node to a graph
+ ** The graph takes ownership of the node and assigns its
+ ** nodeID, the index of the node in the graph
+ ** Nodes added to a directed graph get one-way edges
+ ** Argument is the node to be added
+ ** Special Return Codes:
+ **       -2: Indicates the node already belongs to a graph
+ ************************************************************
+ ************************************************************/
+
+int Graph::addNode(Node *node) {
+    if (node == (Node *)NULL) {
+        return NULL_ARG;
+    }
+    StructureEdit edit(this);
+    if (node->nodeID != (unsigned int)-1) {
+        return -2;
+    }
+    node->nodeID = (unsigned int)this->nodes.size();
+    node->directed = this->directed;
+    this->nodes.push_back(node);
+    this->structureVersion++;
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to split a range of work between threads
+ ** Arguments are the number of threads, the size of the
+ ** range and the work, called once per contiguous chunk
+ ************************************************************
+ ************************************************************/
+
+static void parallelFor(int threadCount, size_t count, const std::function<void(size_t, size_t)> &work) {
+    size_t chunk = (count + threadCount - 1) / threadCount;
+    std::vector<std::thread> threads;
+    int i;
+    for (i = 1; i < threadCount && chunk * i < count; i++) {
+        size_t begin = chunk * i;
+        size_t end = std::min(count, begin + chunk);
+        threads.push_back(std::thread([&work, begin, end]() {
+            work(begin, end);
+        }));
+    }
+    work(0, std::min(count, chunk));
+    for (i = 0; i < (int)threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to find the root of a node in a concurrent
+ ** union-find over node indices
+ ** Halves the path with compare-and-swap, so it may run
+ ** while other threads link roots
+ ************************************************************
+ ************************************************************/
+
+static uint32_t findComponentRoot(std::atomic<uint32_t> *parents, uint32_t node) {
+    uint32_t parent = parents[node].load(std::memory_order_relaxed);
+    while (parent != node) {
+        uint32_t grandparent = parents[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent) {
+            parents[node].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        }
+        node = grandparent;
+        parent = parents[node].load(std::memory_order_relaxed);
+    }
+    return node;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to merge two components of a concurrent
+ ** union-find over node indices
+ ** The root with the larger index is linked under the
+ ** other; a root only stops being one through a successful
+ ** compare-and-swap, so concurrent merges retry until both
+ ** ends share a root
+ ************************************************************
+ ************************************************************/
+
+static void unionComponentRoots(std::atomic<uint32_t> *parents, uint32_t node1, uint32_t node2) {
+    while (true) {
+        node1 = findComponentRoot(parents, node1);
+        node2 = findComponentRoot(parents, node2);
+        if (node1 == node2) {
+            return;
+        }
+        if (node1 < node2) {
+            uint32_t swap = node1;
+            node1 = node2;
+            node2 = swap;
+        }
+        uint32_t expected = node1;
+        if (parents[node1].compare_exchange_strong(expected, node2, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to build a graph from node and edge arrays
+ ** Arguments are the x and y location of every node, the
+ ** edges as pairs of indices into those arrays, whether the
+ ** edges are directed and the number of threads (0 uses
+ ** every core). Node i of the arrays gets nodeID i
+ ** Undirected edges connect both ends, as addNeighbor does;
+ ** directed edges only add the 'to' node to the neighbors
+ ** of the 'from' node. Duplicate edges and self loops are
+ ** dropped. The nodes of a directed graph keep one-way
+ ** semantics afterwards: addNeighbor, removeNeighbor and
+ ** edge costs only apply from the first node to the second
+ ** Edges are bucketed by node with a parallel counting
+ ** sort; every node then sorts and deduplicates its own
+ ** bucket and fills its neighbor queue directly. The
+ ** connectivity index is built alongside with a concurrent
+ ** union-find over the edge array
+ ** Special Return Codes:
+ **       -2: Indicates the graph already has nodes
+ **       OUT_OF_BOUNDS: Indicates an edge to a missing node
+ ************************************************************
+ ************************************************************/
+
+int Graph::build(const float *x, const float *y, int nodeCount, const edge_t *edges, size_t edgeCount,
+                 int directed, int threadCount) {
+    ATLAS_TRACE_SCOPE("Graph::build");
+    StructureEdit edit(this);
+    if (x == (const float *)NULL || y == (const float *)NULL ||
+        (edges == (const edge_t *)NULL && edgeCount > 0)) {
+        return NULL_ARG;
+    }
+    if (nodeCount < 0) {
+        return OUT_OF_BOUNDS;
+    }
+    if (!this->nodes.empty()) {
+        return -2;
+    }
+    if (threadCount < 1) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    //
+    // Count the edges leaving every node
+    //
+
+    std::unique_ptr<std::atomic<uint32_t>[]> degrees(new std::atomic<uint32_t>[nodeCount + 1]);
+    std::atomic<int> badEdge(0);
+    parallelFor(threadCount, (size_t)nodeCount + 1, [&degrees](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            degrees[i].store(0, std::memory_order_relaxed);
+        }
+    });
+    parallelFor(threadCount, edgeCount, [&](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            if (edges[i].from >= (uint32_t)nodeCount || edges[i].to >= (uint32_t)nodeCount) {
+                badEdge.store(1, std::memory_order_relaxed);
+                return;
+            }
+            degrees[edges[i].from].fetch_add(1, std::memory_order_relaxed);
+            if (!directed) {
+                degrees[edges[i].to].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+    if (badEdge.load()) {
+        return OUT_OF_BOUNDS;
+    }
+
+    //
+    // Turn the counts into bucket offsets, then scatter the
+    // edges into their buckets; the counters become cursors
+    //
+
+    std::vector<size_t> offsets((size_t)nodeCount + 1);
+    size_t total = 0;
+    int id;
+    for (id = 0; id < nodeCount; id++) {
+        offsets[id] = total;
+        total += degrees[id].load(std::memory_order_relaxed);
+        degrees[id].store(0, std::memory_order_relaxed);
+    }
+    offsets[nodeCount] = total;
+
+    std::vector<uint32_t> targets(total);
+    parallelFor(threadCount, edgeCount, [&](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            uint32_t from = edges[i].from;
+            uint32_t to = edges[i].to;
+            targets[offsets[from] + degrees[from].fetch_add(1, std::memory_order_relaxed)] = to;
+            if (!directed) {
+                targets[offsets[to] + degrees[to].fetch_add(1, std::memory_order_relaxed)] = from;
+            }
+        }
+    });
+
+    //
+    // Create the nodes, then give every node its neighbors
+    //
+
+    this->directed = directed ? 1 : 0;
+    this->structureVersion++;
+
+    this->nodes.resize(nodeCount);
+    parallelFor(threadCount, (size_t)nodeCount, [&](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            this->nodes[i] = new Node(x[i], y[i]);
+            this->nodes[i]->nodeID = (unsigned int)i;
+            this->nodes[i]->directed = this->directed;
+        }
+    });
+    parallelFor(threadCount, (size_t)nodeCount, [&](size_t begin, size_t end) {
+        std::vector<std::pair<float, uint32_t> > sorted;
+        size_t i, k;
+        for (i = begin; i < end; i++) {
+            Node *node = this->nodes[i];
+            std::vector<uint32_t>::iterator first = targets.begin() + offsets[i];
+            std::vector<uint32_t>::iterator last = targets.begin() + offsets[i + 1];
+            std::sort(first, last);
+            last = std::unique(first, last);
+
+            //
+            // Same order PriorityQueue::insert keeps: farthest
+            // first, ties in insertion order
+            //
+
+            sorted.clear();
+            for (; first != last; ++first) {
+                if (*first == (uint32_t)i) {
+                    continue;
+                }
+                float heuristic = (SHORTEST_PATH_BIAS * 0) +
+                                  (CLOSEST_NODE_BIAS * getNodeDistance(this->nodes[*first], node));
+                sorted.push_back(std::pair<float, uint32_t>(heuristic, *first));
+            }
+            std::stable_sort(sorted.begin(), sorted.end(),
+                             [](const std::pair<float, uint32_t> &a, const std::pair<float, uint32_t> &b) {
+                return a.first > b.first;
+            });
+
+            PriorityQueue *queue = node->neighbors;
+            queue->nodes.resize(sorted.size());
+            queue->heuristics.resize(sorted.size());
+            for (k = 0; k < sorted.size(); k++) {
+                queue->nodes[k] = this->nodes[sorted[k].second];
+                queue->heuristics[k] = sorted[k].first;
+            }
+            queue->count = (int)sorted.size();
+            node->neighborCount = (int)sorted.size();
+        }
+    });
+
+
+    //
+    // Merge the ends of every edge into one component, then
+    // point every node straight at its representative. Edge
+    // direction is ignored, as in rebuildComponents
+    //
+
+    std::unique_ptr<std::atomic<uint32_t>[]> parents(new std::atomic<uint32_t>[nodeCount + 1]);
+    parallelFor(threadCount, (size_t)nodeCount, [&parents](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            parents[i].store((uint32_t)i, std::memory_order_relaxed);
+        }
+    });
+    parallelFor(threadCount, edgeCount, [&](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            if (edges[i].from != edges[i].to) {
+                unionComponentRoots(parents.get(), edges[i].from, edges[i].to);
+            }
+        }
+    });
+    parallelFor(threadCount, (size_t)nodeCount, [&](size_t begin, size_t end) {
+        size_t i;
+        for (i = begin; i < end; i++) {
+            uint32_t root = findComponentRoot(parents.get(), (uint32_t)i);
+            Node *node = this->nodes[i];
+            node->componentParent = this->nodes[root];
+            node->componentRank = (root == (uint32_t)i) ? 1 : 0; // Trees are flat from here
+            node->componentStale = 0;
+        }
+    });
+    this->componentsStale = 0;
+
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to delete a node from a graph
+ ** The node is detached from all of its neighbors (whose
+ ** lists are compacted as in removeNeighbor) and
+ ** tombstoned; it stays allocated (and keeps its nodeID)
+ ** until the next call to compact. In a directed graph the
+ ** edges other nodes hold into it are dropped by compact;
+ ** until then searches skip them
+ ** A new snapshot version is published, so cached results
+ ** that may pass through the node are no longer returned
+ ** Argument is the node to be deleted
+ ** Special Return Codes:
+ **       -1: Indicates the node is not in this graph
+ **       -2: Indicates the node is already deleted
+ ************************************************************
+ ************************************************************/
+
+int Graph::removeNode(Node *node) {
+    if (node == (Node *)NULL) {
+        return NULL_ARG;
+    }
+    StructureEdit edit(this);
+    if (node->nodeID >= this->nodes.size() || this->nodes[node->nodeID] != node) {
+        return -1;
+    }
+    if (node->deleted) {
+        return -2;
+    }
+
+    int i;
+    for (i = 0; i < node->neighbors->getNodeCount(); i++) {
+        Node *neighbor = node->neighbors->getNodeAtIndex(i);
+        if (neighbor != (Node *)NULL && neighbor->neighbors->tombstone(node) == SUCCESS) {
+            neighbor->neighborCount--;
+            if (2 * neighbor->neighbors->getTombstoneCount() > neighbor->neighbors->getNodeCount()) {
+                neighbor->neighbors->compact();
+            }
+        }
+        if (neighbor != (Node *)NULL) {
+            node->neighbors->tombstone(neighbor);
+        }
+    }
+    node->neighbors->compact(); // Now empty
+    node->neighborCount = 0;
+    node->getComponent()->componentStale = 1;
+    node->deleted = 1;
+    this->deletedCount++;
+    this->componentsStale = 1;
+    this->structureVersion++;
+    return this->advanceVersion();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Functions to add and remove an edge of a graph
+ ** As Node::addNeighbor and Node::removeNeighbor, but a new
+ ** snapshot version is published afterwards so results
+ ** cached for older versions are no longer returned
+ ** Arguments are the two nodes of the edge
+ ** Special Return Codes:
+ **       -1: Indicates a node is not in this graph, or for
+ **           removeEdge that the nodes are not neighbors
+ **       -2: Indicates for addEdge that the nodes are
+ **           already neighbors
+ **       -3: Indicates a self loop, which graphs do not
+ **           hold (Graph::build drops them too)
+ ************************************************************
+ ************************************************************/
+
+int Graph::addEdge(Node *node1, Node *node2) {
+    if (node1 == (Node *)NULL || node2 == (Node *)NULL) {
+        return NULL_ARG;
+    }
+    StructureEdit edit(this);
+    if (!this->containsNode(node1) || !this->containsNode(node2)) {
+        return -1;
+    }
+    if (node1 == node2) {
+        return -3;
+    }
+    int rc = node1->addNeighbor(node2);
+    if (rc != SUCCESS) {
+        return rc;
+    }
+    this->structureVersion++;
+    return this->advanceVersion();
+}
+
+int Graph::removeEdge(Node *node1, Node *node2) {
+    if (node1 == (Node *)NULL || node2 == (Node *)NULL) {
+        return NULL_ARG;
+    }
+    StructureEdit edit(this);
+    if (!this->containsNode(node1) || !this->containsNode(node2)) {
+        return -1;
+    }
+    if (node1 == node2) {
+        return -3;
+    }
+    int rc = node1->removeNeighbor(node2);
+    if (rc != SUCCESS) {
+        return rc;
+    }
+    this->componentsStale = 1;
+    this->structureVersion++;
+    return this->dropEdgeCost(node1, node2); // A re-added edge starts at its length
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to check that a node is a live node of a graph
+ ************************************************************
+ ************************************************************/
+
+int Graph::containsNode(const Node *node) const {
+    return node->nodeID < this->nodes.size() && this->nodes[node->nodeID] == node && !node->deleted;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Functions to bracket a search of a graph
+ ** beginSearch waits while a structural edit is pending, so
+ ** the adjacency cannot change until the matching endSearch
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Graph::beginSearch() const {
+    std::unique_lock<std::mutex> guard(this->structureLock);
+    while (this->editCount > 0) {
+        this->structureIdle.wait(guard);
+    }
+    this->searchCount++;
+    return SUCCESS;
+}
+
+int Graph::endSearch() const {
+    std::lock_guard<std::mutex> guard(this->structureLock);
+    this->searchCount--;
+    if (this->searchCount == 0) {
+        this->structureIdle.notify_all();
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Bracket around a search of a graph for the readers in
+ ** this file that have several ways out
+ ************************************************************
+ ************************************************************/
+
+struct GraphSearchScope
+{
+    const Graph *graph;
+
+    GraphSearchScope(const Graph *graph) : graph(graph) {
+        graph->beginSearch();
+    }
+    ~GraphSearchScope() {
+        this->graph->endSearch();
+    }
+};
+
+/***********************************************************
+ ************************************************************
+ ** Constructor and Destructor for Graph::StructureEdit
+ ** Marks an edit as pending, so no new search starts, then
+ ** waits for running searches and edits to finish; the
+ ** destructor lets waiting searches and edits go
+ ************************************************************
+ ************************************************************/
+
+Graph::StructureEdit::StructureEdit(Graph *graph) {
+    this->graph = graph;
+    std::unique_lock<std::mutex> guard(graph->structureLock);
+    graph->editCount++;
+    while (graph->searchCount > 0 || graph->editing) {
+        graph->structureIdle.wait(guard);
+    }
+    graph->editing = 1;
+}
+
+Graph::StructureEdit::~StructureEdit() {
+    std::lock_guard<std::mutex> guard(this->graph->structureLock);
+    this->graph->editing = 0;
+    this->graph->editCount--;
+    this->graph->structureIdle.notify_all();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to publish the unchanged edge costs as the next
+ ** version, after a change to the adjacency
+ ** The override map is shared with the current version
+ ** rather than copied
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Graph::advanceVersion() {
+    std::lock_guard<std::mutex> guard(this->publishLock);
+    std::shared_ptr<const GraphSnapshot> current = std::atomic_load(&this->snapshot);
+    GraphSnapshot *next = new GraphSnapshot(current->version + 1, current->edgeCosts);
+    std::atomic_store(&this->snapshot, std::shared_ptr<const GraphSnapshot>(next));
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to publish the next version without the cost
+ ** override of an edge, after the edge was removed
+ ** The override map is only copied if the edge has one
+ ** Arguments are the two nodes of the edge
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Graph::dropEdgeCost(Node *node1, Node *node2) {
+    std::lock_guard<std::mutex> guard(this->publishLock);
+    std::shared_ptr<const GraphSnapshot> current = std::atomic_load(&this->snapshot);
+    GraphSnapshot::edge_key_t key = GraphSnapshot::makeKey(node1, node2);
+    std::shared_ptr<const GraphSnapshot::edge_cost_map_t> edgeCosts = current->edgeCosts;
+    if (edgeCosts->count(key)) {
+        std::shared_ptr<GraphSnapshot::edge_cost_map_t> remaining =
+            std::make_shared<GraphSnapshot::edge_cost_map_t>(*edgeCosts);
+        remaining->erase(key);
+        edgeCosts = remaining;
+    }
+    GraphSnapshot *next = new GraphSnapshot(current->version + 1, edgeCosts);
+    std::atomic_store(&this->snapshot, std::shared_ptr<const GraphSnapshot>(next));
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to compact a graph
+ ** Frees deleted nodes, squeezes tombstones out of every
+ ** neighbor list and renumbers the remaining nodes densely
+ ** Edge cost overrides that refer to freed nodes or to
+ ** edges that no longer exist, such as edges removed with
+ ** Node::removeNeighbor, are dropped by publishing a new
+ ** snapshot, and the connectivity index
+ ** is rebuilt if a removal left it stale
+ ** Node pointers to deleted nodes are invalid afterwards
+ ** Returns the number of nodes freed
+ ************************************************************
+ ************************************************************/
+
+int Graph::compact() {
+    StructureEdit edit(this);
+    std::vector<Node *> deletedNodes;
+    size_t i;
+    size_t liveIndex = 0;
+
+    for (i = 0; i < this->nodes.size(); i++) {
+        Node *node = this->nodes[i];
+        if (node->deleted) {
+            deletedNodes.push_back(node);
+            continue;
+        }
+        if (this->deletedCount > 0) {
+            //
+            // Directed graphs can still hold edges into deleted nodes
+            //
+            int j;
+            for (j = 0; j < node->neighbors->getNodeCount(); j++) {
+                Node *neighbor = node->neighbors->getNodeAtIndex(j);
+                if (neighbor != (Node *)NULL && neighbor->deleted) {
+                    node->neighbors->tombstone(neighbor);
+                    node->neighborCount--;
+                }
+            }
+        }
+        if (node->neighbors->getTombstoneCount() > 0) {
+            node->neighbors->compact();
+        }
+        node->nodeID = (unsigned int)liveIndex;
+        this->nodes[liveIndex++] = node;
+    }
+    this->nodes.resize(liveIndex);
+    this->nodes.shrink_to_fit();
+    this->deletedCount = 0;
+    if (!deletedNodes.empty()) {
+        this->structureVersion++; // Renumbered
+    }
+    if (!deletedNodes.empty() || this->componentsStale) {
+        this->relabelComponents(); // Drop links into freed nodes and split components
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(this->publishLock);
+        std::shared_ptr<const GraphSnapshot> current = std::atomic_load(&this->snapshot);
+        std::unordered_set<Node *> freed(deletedNodes.begin(), deletedNodes.end());
+        std::shared_ptr<GraphSnapshot::edge_cost_map_t> edgeCosts = std::make_shared<GraphSnapshot::edge_cost_map_t>();
+        GraphSnapshot::edge_cost_map_t::const_iterator edgeCost;
+        for (edgeCost = current->edgeCosts->begin(); edgeCost != current->edgeCosts->end(); ++edgeCost) {
+            Node *node1 = edgeCost->first.first;
+            Node *node2 = edgeCost->first.second;
+            if (!freed.count(node1) && !freed.count(node2) && node1->isNeighbor(node2)) {
+                edgeCosts->insert(*edgeCost);
+            }
+        }
+        if (!deletedNodes.empty() || edgeCosts->size() != current->edgeCosts->size()) {
+            GraphSnapshot *next = new GraphSnapshot(current->version + 1, edgeCosts);
+            std::atomic_store(&this->snapshot, std::shared_ptr<const GraphSnapshot>(next));
+        }
+    }
+
+    for (i = 0; i < deletedNodes.size(); i++) {
+        delete deletedNodes[i];
+    }
+    return (int)deletedNodes.size();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to relabel the connectivity index of a graph
+ ** Rebuilds the union-find from every edge of the graph,
+ ** which clears stale components left behind by edge
+ ** removal, then points every node straight at its
+ ** representative. Edges are merged in both directions, so
+ ** directed graphs get their weakly connected components
+ ** Neighbors outside the graph are not followed
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Graph::rebuildComponents() {
+    StructureEdit edit(this);
+    return this->relabelComponents();
+}
+
+int Graph::relabelComponents() {
+    size_t i;
+    int j;
+
+    for (i = 0; i < this->nodes.size(); i++) {
+        Node *node = this->nodes[i];
+        node->componentParent = node;
+        node->componentRank = 0;
+        node->componentStale = 0;
+    }
+    this->componentsStale = 0;
+    for (i = 0; i < this->nodes.size(); i++) {
+        Node *node = this->nodes[i];
+        if (node->deleted) {
+            continue;
+        }
+        for (j = 0; j < node->neighbors->getNodeCount(); j++) {
+            Node *neighbor = node->neighbors->getNodeAtIndex(j);
+            if (neighbor == (Node *)NULL || neighbor->nodeID >= this->nodes.size() ||
+                this->nodes[neighbor->nodeID] != neighbor) {
+                continue;
+            }
+            node->unionComponent(neighbor);
+        }
+    }
+    for (i = 0; i < this->nodes.size(); i++) {
+        this->nodes[i]->componentParent = this->nodes[i]->compressComponent();
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the node with a given nodeID
+ ** Deleted nodes are returned until the graph is compacted
+ ************************************************************
+ ************************************************************/
+
+Node *Graph::getNodeAtIndex(int index) const {
+    if (index < 0 || index >= (int)this->nodes.size()) {
+        return (Node *)OUT_OF_BOUNDS;
+    }
+    return this->nodes[index];
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the current snapshot of the graph
+ ** Does not lock; the snapshot stays valid and unchanged
+ ** for as long as the caller holds the returned pointer
+ ************************************************************
+ ************************************************************/
+
+std::shared_ptr<const GraphSnapshot> Graph::acquireSnapshot() const {
+    return std::atomic_load(&this->snapshot);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to publish a batch of edge updates
+ ** The current overlay is copied, the whole batch is applied
+ ** to the copy and the copy is swapped in as the next
+ ** version, so readers see either none or all of the batch
+ ** Costs queued for edges that were removed since are
+ ** skipped, so a re-added edge starts at its length
+ ** Argument is the batch to be published
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Graph::publish(const EdgeUpdateBatch *batch) {
+    if (batch == (const EdgeUpdateBatch *)NULL) {
+        return NULL_ARG;
+    }
+
+    std::lock_guard<std::mutex> guard(this->publishLock);
+    std::shared_ptr<const GraphSnapshot> current = std::atomic_load(&this->snapshot);
+    std::shared_ptr<GraphSnapshot::edge_cost_map_t> edgeCosts =
+        std::make_shared<GraphSnapshot::edge_cost_map_t>(*current->edgeCosts);
+
+    size_t i;
+    for (i = 0; i < batch->updates.size(); i++) {
+        const edge_update_t &update = batch->updates[i];
+        GraphSnapshot::edge_key_t key = GraphSnapshot::makeKey(update.node1, update.node2);
+        if (update.reset) {
+            edgeCosts->erase(key);
+        }
+        else if (update.node1->isNeighbor(update.node2)) {
+            (*edgeCosts)[key] = update.cost;
+        }
+    }
+
+    GraphSnapshot *next = new GraphSnapshot(current->version + 1, edgeCosts);
+    std::atomic_store(&this->snapshot, std::shared_ptr<const GraphSnapshot>(next));
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the version of the current snapshot
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+unsigned long Graph::getVersion() const {
+    return this->acquireSnapshot()->getVersion();
+}
+
+/***********************************************************
+************************************************************
+** Function implementation for AStar with a PathCache
+**  Arguments are starting node, goal node, the snapshot
+**  supplying edge costs, an optional output path and an
+**  optional cache shared between searches
+**  Results are cached under the version of the snapshot;
+**  searches without a snapshot bypass the cache
+** Returns a -1 if a path does not exist between nodes
+************************************************************
+************************************************************/
+
+int AStar(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path, PathCache* cache) {
+    return AStar(startNode, goalNode, snapshot, path, cache, (SearchControl*)NULL);
+}
+
+/***********************************************************
+************************************************************
+** Function implementation for AStar with a SearchControl
+**  Arguments are as for AStar with a PathCache plus an
+**  optional control for cancellation and budgets
+**  Cancelled and over-budget searches are not cached; a
+**  cancelled control is rejected before the cache is
+**  consulted and a cache hit counts 0 expansions
+** Returns a -1 if a path does not exist between nodes
+**  SEARCH_CANCELLED if the control was cancelled and
+**  BUDGET_EXCEEDED if a budget of the control ran out
+************************************************************
+************************************************************/
+
+int AStar(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path, PathCache* cache, SearchControl* control) {
+    if (startNode == (Node*)NULL || goalNode == (Node*)NULL) {
+        return NULL_ARG;
+    }
+    if (cache == (PathCache*)NULL || snapshot == (const GraphSnapshot*)NULL) {
+        return searchSnapshot(startNode, goalNode, snapshot, path, control); // No version to cache under
+    }
+
+    if (control != (SearchControl*)NULL && control->begin() == SEARCH_CANCELLED) {
+        return SEARCH_CANCELLED; // Also resets the expansion count for a hit
+    }
+
+    unsigned long version = snapshot->getVersion();
+
+    int rc = cache->lookup(startNode, goalNode, version, path);
+    if (rc != -3) {
+        return rc;
+    }
+
+    std::vector<Node*> foundPath;
+    rc = searchSnapshot(startNode, goalNode, snapshot, &foundPath, control);
+    cache->store(startNode, goalNode, version, rc, &foundPath);
+    if (path != (std::vector<Node*>*)NULL) {
+        path->swap(foundPath);
+    }
+    return rc;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructor for PathCache Type
+ ** Argument is the maximum number of cached searches
+ ************************************************************
+ ************************************************************/
+
+PathCache::PathCache(int capacity) {
+    this->capacity = capacity > 0 ? (size_t)capacity : 1;
+    this->hitCount = 0;
+    this->missCount = 0;
+    this->evictionCount = 0;
+    this->invalidationCount = 0;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to look up a cached search
+ ** Arguments are the start and goal node, the snapshot
+ ** version of the search and an optional output path
+ ** A hit marks the entry as most recently used
+ ** Special Return Codes:
+ **       -1: Indicates a cached search found no path
+ **       -3: Indicates no entry for this version
+ ************************************************************
+ ************************************************************/
+
+int PathCache::lookup(Node *startNode, Node *goalNode, unsigned long version, std::vector<Node *> *path) {
+    if (startNode == (Node *)NULL || goalNode == (Node *)NULL) {
+        return NULL_ARG;
+    }
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    std::unordered_map<query_key_t, std::list<cache_entry_t>::iterator, QueryKeyHash>::iterator found =
+        this->index.find(query_key_t(startNode, goalNode));
+
+    if (found == this->index.end()) {
+        this->missCount++;
+        return -3;
+    }
+
+    std::list<cache_entry_t>::iterator entry = found->second;
+    if (entry->version != version) {
+        if (entry->version < version) {
+            //
+            // The graph has moved on; the entry can never hit again
+            //
+            this->entries.erase(entry);
+            this->index.erase(found);
+            this->invalidationCount++;
+        }
+        this->missCount++;
+        return -3;
+    }
+
+    this->entries.splice(this->entries.begin(), this->entries, entry);
+    if (path != (std::vector<Node *> *)NULL) {
+        *path = entry->path;
+    }
+    this->hitCount++;
+    return entry->result;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to cache the result of a search
+ ** Arguments are the start and goal node, the snapshot
+ ** version of the search, its return code and its path
+ ** Only SUCCESS and -1 results are cached; an entry for a
+ ** newer version is never replaced by an older one
+ ** The least recently used entry is evicted when full
+ ** Special Return Codes:
+ **       -2: Indicates the result was not cached
+ ************************************************************
+ ************************************************************/
+
+int PathCache::store(Node *startNode, Node *goalNode, unsigned long version, int result, const std::vector<Node *> *path) {
+    if (startNode == (Node *)NULL || goalNode == (Node *)NULL) {
+        return NULL_ARG;
+    }
+    if (result != SUCCESS && result != -1) {
+        return -2;
+    }
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    query_key_t key(startNode, goalNode);
+    std::unordered_map<query_key_t, std::list<cache_entry_t>::iterator, QueryKeyHash>::iterator found =
+        this->index.find(key);
+
+    if (found != this->index.end()) {
+        if (found->second->version > version) {
+            return -2;
+        }
+        this->entries.erase(found->second);
+        this->index.erase(found);
+    }
+    else if (this->entries.size() >= this->capacity) {
+        this->index.erase(this->entries.back().key);
+        this->entries.pop_back();
+        this->evictionCount++;
+    }
+
+    cache_entry_t entry;
+    entry.key = key;
+    entry.version = version;
+    entry.result = result;
+    if (path != (const std::vector<Node *> *)NULL && result == SUCCESS) {
+        entry.path = *path;
+    }
+    this->entries.push_front(entry);
+    this->index[key] = this->entries.begin();
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to drop every cached search
+ ** Statistics are kept
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int PathCache::clear() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->entries.clear();
+    this->index.clear();
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Statistics accessors for PathCache
+ ** The hit rate is hits over lookups, 0 before any lookup
+ ************************************************************
+ ************************************************************/
+
+int PathCache::getEntryCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return (int)this->entries.size();
+}
+
+unsigned long PathCache::getHitCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->hitCount;
+}
+
+unsigned long PathCache::getMissCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->missCount;
+}
+
+unsigned long PathCache::getEvictionCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->evictionCount;
+}
+
+unsigned long PathCache::getInvalidationCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->invalidationCount;
+}
+
+float PathCache::getHitRate() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    unsigned long lookups = this->hitCount + this->missCount;
+    if (lookups == 0) {
+        return 0;
+    }
+    return (float)this->hitCount / lookups;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructor for SearchControl Type
+ ** Arguments are the maximum number of expanded nodes and
+ ** the time budget in microseconds; 0 means unlimited
+ ************************************************************
+ ************************************************************/
+
+SearchControl::SearchControl(long maxExpansions, long timeBudgetUs) {
+    this->cancelled.store(0);
+    this->maxExpansions = maxExpansions;
+    this->timeBudgetUs = timeBudgetUs;
+    this->expansions = 0;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to start a search under this control
+ ** Resets the expansion count and starts the time budget
+ ** Special Return Codes:
+ **       SEARCH_CANCELLED: Indicates the control was cancelled
+ ************************************************************
+ ************************************************************/
+
+int SearchControl::begin() {
+    this->expansions = 0;
+    this->deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(this->timeBudgetUs);
+    if (this->isCancelled()) {
+        return SEARCH_CANCELLED;
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to account for one expanded node
+ ** The clock is only read every 64 expansions
+ ** Special Return Codes:
+ **       SEARCH_CANCELLED: Indicates the control was cancelled
+ **       BUDGET_EXCEEDED: Indicates a budget ran out
+ ************************************************************
+ ************************************************************/
+
+int SearchControl::expand() {
+    if (this->isCancelled()) {
+        return SEARCH_CANCELLED;
+    }
+    this->expansions++;
+    if (this->maxExpansions > 0 && this->expansions > this->maxExpansions) {
+        return BUDGET_EXCEEDED;
+    }
+    if (this->timeBudgetUs > 0 && (this->expansions & 63) == 0 &&
+        std::chrono::steady_clock::now() > this->deadline) {
+        return BUDGET_EXCEEDED;
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to cancel searches under this control
+ ** Safe to call from any thread; the search stops at its
+ ** next expansion
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int SearchControl::cancel() {
+    this->cancelled.store(1, std::memory_order_relaxed);
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructor for QueryExecutor Type
+ ** Arguments are the graph to be searched, the number of
+ ** worker threads and an optional cache shared by them
+ ************************************************************
+ ************************************************************/
+
+QueryExecutor::QueryExecutor(Graph *graph, int workerCount, PathCache *cache) {
+    this->graph = graph;
+    this->cache = cache;
+    this->stopping = 0;
+    if (workerCount < 1) {
+        workerCount = 1;
+    }
+    this->running.resize(workerCount);
+    int i;
+    for (i = 0; i < workerCount; i++) {
+        this->workers.push_back(std::thread(&QueryExecutor::runWorker, this, i));
+    }
+}
+
+/***********************************************************
+ ************************************************************
+ ** Destructor for QueryExecutor Type
+ ** Shuts the pool down
+ ************************************************************
+ ************************************************************/
+
+QueryExecutor::~QueryExecutor() {
+    this->shutdown();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Worker loop of a QueryExecutor
+ ** Takes queries in submission order until shutdown
+ ** The control of the query is published in the running
+ ** slot of the worker until its callback has returned, so
+ ** shutdown can cancel it
+ ** Argument is the index of the worker
+ ************************************************************
+ ************************************************************/
+
+void QueryExecutor::runWorker(int index) {
+    while (1) {
+        query_task_t task;
+        int cancelTask;
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            while (!this->stopping && this->tasks.empty()) {
+                this->wake.wait(guard);
+            }
+            if (this->tasks.empty()) {
+                return;
+            }
+            task = this->tasks.front();
+            this->tasks.pop_front();
+            cancelTask = this->stopping;
+            if (!cancelTask) {
+                this->running[index] = task.control;
+            }
+        }
+
+        query_result_t result;
+        result.version = 0;
+        result.expansions = 0;
+        if (cancelTask) {
+            result.result = SEARCH_CANCELLED;
+        }
+        else {
+            this->graph->beginSearch(); // Waits out pending structural edits
+            std::shared_ptr<const GraphSnapshot> snapshot = this->graph->acquireSnapshot();
+            result.version = snapshot->getVersion();
+            result.result = AStar(task.startNode, task.goalNode, snapshot.get(), &result.path,
+                                  this->cache, task.control.get());
+            result.expansions = task.control->getExpansions();
+            this->graph->endSearch(); // Before the callback, which may edit the graph
+        }
+        task.callback(result);
+        if (!cancelTask) {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->running[index].reset();
+        }
+    }
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to submit a query answered through a future
+ ** Arguments are the start and goal node and an optional
+ ** control the caller keeps to cancel the query
+ ** A NULL start or goal resolves the future as NULL_ARG
+ ************************************************************
+ ************************************************************/
+
+std::future<query_result_t> QueryExecutor::submit(Node *startNode, Node *goalNode, std::shared_ptr<SearchControl> control) {
+    std::shared_ptr<std::promise<query_result_t> > promise(new std::promise<query_result_t>());
+    std::future<query_result_t> future = promise->get_future();
+    int rc = this->submit(startNode, goalNode, control, [promise](const query_result_t &result) {
+        promise->set_value(result);
+    });
+    if (rc != SUCCESS) {
+        query_result_t result;
+        result.result = rc;
+        result.version = 0;
+        result.expansions = 0;
+        promise->set_value(result);
+    }
+    return future;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to submit a query answered through a callback
+ ** Arguments are the start and goal node, an optional
+ ** control and the callback, which runs on a worker thread
+ ** Special Return Codes:
+ **       SEARCH_CANCELLED: Indicates the executor is shut down
+ ************************************************************
+ ************************************************************/
+
+int QueryExecutor::submit(Node *startNode, Node *goalNode, std::shared_ptr<SearchControl> control,
+                          std::function<void(const query_result_t &)> callback) {
+    if (startNode == (Node *)NULL || goalNode == (Node *)NULL || !callback) {
+        return NULL_ARG;
+    }
+
+    query_task_t task;
+    task.startNode = startNode;
+    task.goalNode = goalNode;
+    task.control = control ? control : std::shared_ptr<SearchControl>(new SearchControl(0, 0));
+    task.callback = callback;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (this->stopping) {
+            return SEARCH_CANCELLED;
+        }
+        this->tasks.push_back(task);
+    }
+    this->wake.notify_one();
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to shut a QueryExecutor down
+ ** Queued queries resolve as SEARCH_CANCELLED; the controls
+ ** of running queries are cancelled, so their searches stop
+ ** at the next expansion even without a budget. Controls
+ ** passed to submit are cancelled too
+ ** Must not be called from a query callback, as it joins
+ ** the worker threads
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int QueryExecutor::shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = 1;
+        size_t i;
+        for (i = 0; i < this->running.size(); i++) {
+            if (this->running[i]) {
+                this->running[i]->cancel();
+            }
+        }
+    }
+    this->wake.notify_all();
+    size_t i;
+    for (i = 0; i < this->workers.size(); i++) {
+        if (this->workers[i].joinable()) {
+            this->workers[i].join();
+        }
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the number of queries not yet started
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int QueryExecutor::getPendingCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return (int)this->tasks.size();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructor for CompressedGraph Type
+ ** The graph is empty until build is called
+ ************************************************************
+ ************************************************************/
+
+CompressedGraph::CompressedGraph() {
+    this->tileSize = 0;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to interleave the bits of two coordinates
+ ** Orders tiles, and the nodes within a tile, along a
+ ** Z-curve
+ ************************************************************
+ ************************************************************/
+
+static uint64_t mortonCode(uint32_t x, uint32_t y) {
+    uint64_t code = 0;
+    int bit;
+    for (bit = 0; bit < 32; bit++) {
+        code |= (uint64_t)((x >> bit) & 1) << (2 * bit);
+        code |= (uint64_t)((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return code;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Functions to write and read an unsigned LEB128 varint
+ ************************************************************
+ ************************************************************/
+
+static void writeVarint(std::vector<uint8_t> *bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes->push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    bytes->push_back((uint8_t)value);
+}
+
+static const uint8_t *readVarint(const uint8_t *bytes, uint32_t *value) {
+    uint32_t result = 0;
+    int shift = 0;
+    while (*bytes & 0x80) {
+        result |= (uint32_t)(*bytes++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *value = result | ((uint32_t)*bytes++ << shift);
+    return bytes;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to build a compressed copy of a graph
+ ** Arguments are the graph and the edge length of a tile
+ ** Locations are quantized to tileSize / 65535, so pick the
+ ** smallest tile that keeps the number of tiles reasonable
+ ** Deleted nodes and neighbors outside the graph are left out
+ ** Special Return Codes:
+ **       -2: Indicates a tile size that is not positive
+ ************************************************************
+ ************************************************************/
+
+int CompressedGraph::build(const Graph *graph, float tileSize) {
+    if (graph == (const Graph *)NULL) {
+        return NULL_ARG;
+    }
+    if (!(tileSize > 0)) {
+        return -2;
+    }
+    GraphSearchScope search(graph);
+
+    typedef struct
+    {
+        int32_t tileX;
+        int32_t tileY;
+        uint64_t tileMorton;
+        uint64_t morton;
+        uint32_t nodeID;
+        uint16_t offsetX;
+        uint16_t offsetY;
+    } placement_t;
+
+    this->tileSize = tileSize;
+    this->tileX.clear();
+    this->tileY.clear();
+    this->tileFirst.clear();
+    this->offsets.clear();
+    this->adjacencyStart.clear();
+    this->adjacency.clear();
+    this->nodeIDs.clear();
+    this->indices.assign(graph->getNodeCount(), UINT32_MAX);
+
+    //
+    // Quantize every live node into its tile
+    //
+
+    std::vector<placement_t> placements;
+    int32_t minTileX = INT32_MAX;
+    int32_t minTileY = INT32_MAX;
+    int id;
+    for (id = 0; id < graph->getNodeCount(); id++) {
+        Node *node = graph->getNodeAtIndex(id);
+        if (node->isDeleted()) {
+            continue;
+        }
+        point_t location = node->getLocation();
+        placement_t placement;
+        float cellX = floorf(location.x / tileSize);
+        float cellY = floorf(location.y / tileSize);
+        float fractionX = location.x / tileSize - cellX;
+        float fractionY = location.y / tileSize - cellY;
+        placement.tileX = (int32_t)cellX;
+        placement.tileY = (int32_t)cellY;
+        placement.offsetX = (uint16_t)std::min(65535L, std::max(0L, lroundf(fractionX * 65535)));
+        placement.offsetY = (uint16_t)std::min(65535L, std::max(0L, lroundf(fractionY * 65535)));
+        placement.morton = mortonCode(placement.offsetX, placement.offsetY);
+        placement.nodeID = (uint32_t)id;
+        placements.push_back(placement);
+        minTileX = std::min(minTileX, placement.tileX);
+        minTileY = std::min(minTileY, placement.tileY);
+    }
+
+    //
+    // Number the tiles along a Z-curve too, so neighboring
+    // tiles (and the nodes on either side of a tile border)
+    // stay close in index
+    //
+
+    size_t i;
+    for (i = 0; i < placements.size(); i++) {
+        placements[i].tileMorton = mortonCode((uint32_t)((int64_t)placements[i].tileX - minTileX),
+                                              (uint32_t)((int64_t)placements[i].tileY - minTileY));
+    }
+
+    std::sort(placements.begin(), placements.end(), [](const placement_t &a, const placement_t &b) {
+        if (a.tileMorton != b.tileMorton) {
+            return a.tileMorton < b.tileMorton;
+        }
+        if (a.morton != b.morton) {
+            return a.morton < b.morton;
+        }
+        return a.nodeID < b.nodeID;
+    });
+
+    for (i = 0; i < placements.size(); i++) {
+        const placement_t &placement = placements[i];
+        if (i == 0 || placement.tileX != this->tileX.back() || placement.tileY != this->tileY.back()) {
+            this->tileX.push_back(placement.tileX);
+            this->tileY.push_back(placement.tileY);
+            this->tileFirst.push_back((uint32_t)i);
+        }
+        this->offsets.push_back(placement.offsetX);
+        this->offsets.push_back(placement.offsetY);
+        this->nodeIDs.push_back(placement.nodeID);
+        this->indices[placement.nodeID] = (uint32_t)i;
+    }
+    this->tileFirst.push_back((uint32_t)placements.size());
+
+    //
+    // Encode each neighbor list as the zigzag distance from the
+    // node to its first neighbor, then gaps between neighbors
+    //
+
+    std::vector<uint32_t> neighbors;
+    for (i = 0; i < this->nodeIDs.size(); i++) {
+        Node *node = graph->getNodeAtIndex(this->nodeIDs[i]);
+        PriorityQueue *queue = node->getNeighbors();
+        int j;
+        neighbors.clear();
+        for (j = 0; j < queue->getNodeCount(); j++) {
+            Node *neighbor = queue->getNodeAtIndex(j);
+            if (neighbor == (Node *)NULL) {
+                continue;
+            }
+            int index = this->getIndex(neighbor);
+            if (index < 0 || graph->getNodeAtIndex(neighbor->getNodeID()) != neighbor) {
+                continue;
+            }
+            neighbors.push_back((uint32_t)index);
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+        this->adjacencyStart.push_back((uint32_t)this->adjacency.size());
+        size_t k;
+        for (k = 0; k < neighbors.size(); k++) {
+            if (k == 0) {
+                int32_t delta = (int32_t)(neighbors[0] - (uint32_t)i);
+                writeVarint(&this->adjacency, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            }
+            else {
+                writeVarint(&this->adjacency, neighbors[k] - neighbors[k-1]);
+            }
+        }
+    }
+    this->adjacencyStart.push_back((uint32_t)this->adjacency.size());
+
+    this->tileX.shrink_to_fit();
+    this->tileY.shrink_to_fit();
+    this->tileFirst.shrink_to_fit();
+    this->offsets.shrink_to_fit();
+    this->adjacencyStart.shrink_to_fit();
+    this->adjacency.shrink_to_fit();
+    this->nodeIDs.shrink_to_fit();
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to find the tile holding a node
+ ** Binary search over the first node of each tile
+ ************************************************************
+ ************************************************************/
+
+int CompressedGraph::getTileOfIndex(int index) const {
+    std::vector<uint32_t>::const_iterator next =
+        std::upper_bound(this->tileFirst.begin(), this->tileFirst.end() - 1, (uint32_t)index);
+    return (int)(next - this->tileFirst.begin()) - 1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to decode the location of a node
+ ** Argument is the index of the node
+ ** Special Return Codes:
+ **       OUT_OF_BOUNDS in both coordinates for a bad index
+ ************************************************************
+ ************************************************************/
+
+point_t CompressedGraph::getLocation(int index) const {
+    point_t location;
+    if (index < 0 || index >= this->getNodeCount()) {
+        location.x = OUT_OF_BOUNDS;
+        location.y = OUT_OF_BOUNDS;
+        return location;
+    }
+    int tile = this->getTileOfIndex(index);
+    location.x = (this->tileX[tile] + this->offsets[2 * index] / 65535.0f) * this->tileSize;
+    location.y = (this->tileY[tile] + this->offsets[2 * index + 1] / 65535.0f) * this->tileSize;
+    return location;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to decode the neighbors of a node
+ ** Arguments are the index of the node and the vector that
+ ** receives the neighbor indices in ascending order
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int CompressedGraph::getNeighbors(int index, std::vector<int> *neighbors) const {
+    if (neighbors == (std::vector<int> *)NULL) {
+        return NULL_ARG;
+    }
+    if (index < 0 || index >= this->getNodeCount()) {
+        return OUT_OF_BOUNDS;
+    }
+    neighbors->clear();
+
+    const uint8_t *bytes = this->adjacency.data() + this->adjacencyStart[index];
+    const uint8_t *end = this->adjacency.data() + this->adjacencyStart[index + 1];
+    uint32_t value;
+    if (bytes == end) {
+        return SUCCESS;
+    }
+    bytes = readVarint(bytes, &value);
+    int neighbor = index + (int32_t)((value >> 1) ^ (0U - (value & 1)));
+    neighbors->push_back(neighbor);
+    while (bytes < end) {
+        bytes = readVarint(bytes, &value);
+        neighbor += (int)value;
+        neighbors->push_back(neighbor);
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the compressed index of a source node
+ ** Returns -1 if the node was not part of the build
+ ************************************************************
+ ************************************************************/
+
+int CompressedGraph::getIndex(const Node *node) const {
+    if (node == (const Node *)NULL) {
+        return NULL_ARG;
+    }
+    if (node->getNodeID() >= this->indices.size() || this->indices[node->getNodeID()] == UINT32_MAX) {
+        return -1;
+    }
+    return (int)this->indices[node->getNodeID()];
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the source nodeID of a compressed node
+ ** Returns (unsigned int)-1 for a bad index
+ ************************************************************
+ ************************************************************/
+
+unsigned int CompressedGraph::getNodeID(int index) const {
+    if (index < 0 || index >= this->getNodeCount()) {
+        return (unsigned int)-1;
+    }
+    return this->nodeIDs[index];
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the bytes held by a compressed graph
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+size_t CompressedGraph::getMemoryUsage() const {
+    return sizeof(*this) +
+           this->tileX.capacity() * sizeof(int32_t) +
+           this->tileY.capacity() * sizeof(int32_t) +
+           this->tileFirst.capacity() * sizeof(uint32_t) +
+           this->offsets.capacity() * sizeof(uint16_t) +
+           this->adjacencyStart.capacity() * sizeof(uint32_t) +
+           this->adjacency.capacity() * sizeof(uint8_t) +
+           this->nodeIDs.capacity() * sizeof(uint32_t) +
+           this->indices.capacity() * sizeof(uint32_t);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the distance between two points
+ ************************************************************
+ ************************************************************/
+
+static inline float getPointDistance(point_t point1, point_t point2) {
+    return sqrt((point1.x - point2.x) * (point1.x - point2.x) +
+                (point1.y - point2.y) * (point1.y - point2.y));
+}
+
+/***********************************************************
+************************************************************
+** Function implementation for AStar on a CompressedGraph
+**  Arguments are the graph, start and goal index and an
+**  optional output path of node indices
+**  Uses the same path and distance biases as the other
+**  searches; neighbor lists are decoded on expansion
+** Returns a -1 if a path does not exist between nodes
+************************************************************
+************************************************************/
+
+int AStar(const CompressedGraph* graph, int startIndex, int goalIndex, std::vector<int>* path) {
+    ATLAS_TRACE_SCOPE("AStar");
+    if (graph == (const CompressedGraph*)NULL) {
+        return NULL_ARG;
+    }
+    if (startIndex < 0 || startIndex >= graph->getNodeCount() ||
+        goalIndex < 0 || goalIndex >= graph->getNodeCount()) {
+        return OUT_OF_BOUNDS;
+    }
+    if (path != (std::vector<int>*)NULL) {
+        path->clear();
+    }
+
+    typedef std::pair<float, int> open_entry_t;
+    typedef struct
+    {
+        int index;
+        float pathLength;
+        point_t location;
+    } improved_t; // A neighbor reached by a shorter path
+
+    std::priority_queue<open_entry_t, std::vector<open_entry_t>, std::greater<open_entry_t> > queue;
+    std::unordered_map<int, float> pathLengths;
+    std::unordered_map<int, int> previous;
+    std::vector<int> neighbors;
+    std::vector<improved_t> improved;
+    std::vector<float> heuristics;
+    point_t goalLocation = graph->getLocation(goalIndex);
+    size_t i;
+
+    pathLengths[startIndex] = 0;
+    queue.push(open_entry_t(CLOSEST_NODE_BIAS * getPointDistance(graph->getLocation(startIndex), goalLocation), startIndex));
+
+    while (!queue.empty()) {
+        ATLAS_TRACE_SAMPLE();
+        open_entry_t top;
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::queue");
+            top = queue.top();
+            queue.pop();
+        }
+        int currentIndex = top.second;
+
+        if (currentIndex == goalIndex) {
+            if (path != (std::vector<int>*)NULL) {
+                int pathIndex = goalIndex;
+                while (pathIndex != startIndex) {
+                    path->push_back(pathIndex);
+                    pathIndex = previous[pathIndex];
+                }
+                path->push_back(startIndex);
+                std::reverse(path->begin(), path->end());
+            }
+            return SUCCESS;
+        }
+
+        float currentLength = pathLengths[currentIndex];
+        point_t currentLocation = graph->getLocation(currentIndex);
+        float currentHeuristic = (SHORTEST_PATH_BIAS * currentLength) +
+                                 (CLOSEST_NODE_BIAS * getPointDistance(currentLocation, goalLocation));
+        if (top.first > currentHeuristic) {
+            continue; // Superseded by a shorter path to the same node
+        }
+
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::expand");
+            graph->getNeighbors(currentIndex, &neighbors);
+            improved.clear();
+            for (i = 0; i < neighbors.size(); i++) {
+                improved_t next;
+                next.index = neighbors[i];
+                next.location = graph->getLocation(next.index);
+                next.pathLength = currentLength + getPointDistance(currentLocation, next.location);
+                std::unordered_map<int, float>::iterator known = pathLengths.find(next.index);
+                if (known != pathLengths.end() && known->second <= next.pathLength) {
+                    continue;
+                }
+                pathLengths[next.index] = next.pathLength;
+                previous[next.index] = currentIndex;
+                improved.push_back(next);
+            }
+        }
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::heuristic");
+            heuristics.resize(improved.size());
+            for (i = 0; i < improved.size(); i++) {
+                heuristics[i] = (SHORTEST_PATH_BIAS * improved[i].pathLength) +
+                                (CLOSEST_NODE_BIAS * getPointDistance(improved[i].location, goalLocation));
+            }
+        }
+        {
+            ATLAS_TRACE_SAMPLED_SCOPE("AStar::queue");
+            for (i = 0; i < improved.size(); i++) {
+                queue.push(open_entry_t(heuristics[i], improved[i].index));
+            }
+        }
+    }
+
+    return -1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Helpers for the PartitionOverlay
+ ** isGraphNode checks that a neighbor belongs to the graph
+ ** getOverlayEdgeCost reads a cost from an optional snapshot
+ ************************************************************
+ ************************************************************/
+
+static inline int isGraphNode(const Graph *graph, Node *node) {
+    return node != (Node *)NULL &&
+           node->getNodeID() < (unsigned int)graph->getNodeCount() &&
+           graph->getNodeAtIndex(node->getNodeID()) == node;
+}
+
+static inline float getOverlayEdgeCost(const GraphSnapshot *snapshot, Node *node1, Node *node2) {
+    if (snapshot != (const GraphSnapshot *)NULL) {
+        return snapshot->getEdgeCost(node1, node2);
+    }
+    return getNodeDistance(node1, node2);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to bisect a range of nodes recursively
+ ** Splits at the median of the longer side of the bounding
+ ** box and gives every node the bit path of its leaf
+ ************************************************************
+ ************************************************************/
+
+static void bisectNodes(const Graph *graph, std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end,
+                        int depth, int maxDepth, uint32_t code, std::vector<uint32_t> *leafCodes) {
+    std::vector<uint32_t>::iterator it;
+    if (depth == maxDepth || end - begin <= 1) {
+        code <<= (maxDepth - depth);
+        for (it = begin; it != end; ++it) {
+            (*leafCodes)[*it] = code;
+        }
+        return;
+    }
+
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for (it = begin; it != end; ++it) {
+        point_t location = graph->getNodeAtIndex(*it)->getLocation();
+        minX = std::min(minX, location.x);
+        maxX = std::max(maxX, location.x);
+        minY = std::min(minY, location.y);
+        maxY = std::max(maxY, location.y);
+    }
+    int splitX = (maxX - minX) >= (maxY - minY);
+
+    std::vector<uint32_t>::iterator middle = begin + (end - begin) / 2;
+    std::nth_element(begin, middle, end, [graph, splitX](uint32_t a, uint32_t b) {
+        point_t locationA = graph->getNodeAtIndex(a)->getLocation();
+        point_t locationB = graph->getNodeAtIndex(b)->getLocation();
+        return splitX ? locationA.x < locationB.x : locationA.y < locationB.y;
+    });
+    bisectNodes(graph, begin, middle, depth + 1, maxDepth, code << 1, leafCodes);
+    bisectNodes(graph, middle, end, depth + 1, maxDepth, (code << 1) | 1, leafCodes);
+}
+
+/***********************************************************
+ ************************************************************
+ ** Constructor for PartitionOverlay Type
+ ** The overlay is empty until build is called
+ ************************************************************
+ ************************************************************/
+
+PartitionOverlay::PartitionOverlay() {
+    this->graph = (const Graph *)NULL;
+    this->levelCount = 0;
+    this->nodeCount = 0;
+    this->structureVersion = 0;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to partition a graph into nested cells
+ ** Arguments are the graph, the number of levels and the
+ ** largest number of nodes in a level 0 cell
+ ** Each level above level 0 merges several cells of the
+ ** level below; the top level has at least two cells if
+ ** the graph has two nodes. The bisection never goes below
+ ** cells of one node, so a level count above
+ ** ceil(log2(nodeCount)) is reduced to it; getLevelCount
+ ** returns the number of levels built
+ ** Cells are numbered densely per level, so empty leaves of
+ ** the bisection take no space
+ ** Records the node count and structure version of the
+ ** graph; call build again after changing the adjacency
+ ** Special Return Codes:
+ **       -2: Indicates a level count outside 1 to 30 or a
+ **           cell size below 1
+ **       -3: Indicates deleted nodes; compact the graph first
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::build(const Graph *graph, int levelCount, int cellSize) {
+    if (graph == (const Graph *)NULL) {
+        return NULL_ARG;
+    }
+    if (levelCount < 1 || levelCount > 30 || cellSize < 1) {
+        return -2; // Cells are numbered by up to 30 bisections
+    }
+    GraphSearchScope search(graph);
+    if (graph->getDeletedCount() > 0) {
+        return -3;
+    }
+
+    int nodeCount = graph->getNodeCount();
+    int maxDepth = 0;
+    while (maxDepth < 30 && ((long)1 << maxDepth) < nodeCount) {
+        maxDepth++; // ceil(log2(nodeCount)) bisections leave single nodes
+    }
+    int depth = 0;
+    while (depth < maxDepth && ((long)nodeCount >> depth) > cellSize) {
+        depth++;
+    }
+    levelCount = std::max(1, std::min(levelCount, maxDepth));
+    depth = std::max(depth, levelCount);
+    int step = levelCount > 1 ? (depth - 1) / (levelCount - 1) : 0;
+
+    std::vector<uint32_t> order(nodeCount);
+    std::vector<uint32_t> leafCodes(nodeCount, 0);
+    int id, level, j;
+    for (id = 0; id < nodeCount; id++) {
+        order[id] = (uint32_t)id;
+    }
+    bisectNodes(graph, order.begin(), order.end(), 0, depth, 0, &leafCodes);
+
+    this->graph = graph;
+    this->levelCount = levelCount;
+    this->nodeCount = nodeCount;
+    this->structureVersion = graph->getStructureVersion();
+    this->cellOfNode.assign(levelCount, std::vector<uint32_t>(nodeCount));
+    this->boundaryIndex.assign(levelCount, std::vector<int32_t>(nodeCount, -1));
+    this->cells.assign(levelCount, std::vector<cell_t>());
+    std::atomic_store(&this->metric, std::shared_ptr<const OverlayMetric>());
+
+    //
+    // Both ends of a cut edge are boundary nodes, so in a
+    // directed graph the nodes only entered from outside the
+    // cell are too
+    //
+
+    std::vector<uint8_t> onBoundary(nodeCount);
+    std::vector<int32_t> denseCell;
+    for (level = 0; level < levelCount; level++) {
+        int shift = level * step;
+        uint32_t cellCount = 0;
+        denseCell.assign((size_t)1 << (depth - shift), -1); // At most 2 * nodeCount codes
+        for (id = 0; id < nodeCount; id++) {
+            uint32_t code = leafCodes[id] >> shift;
+            if (denseCell[code] < 0) {
+                denseCell[code] = (int32_t)cellCount++;
+            }
+            this->cellOfNode[level][id] = (uint32_t)denseCell[code];
+        }
+        this->cells[level].resize(cellCount);
+        std::fill(onBoundary.begin(), onBoundary.end(), 0);
+        for (id = 0; id < nodeCount; id++) {
+            Node *node = graph->getNodeAtIndex(id);
+            uint32_t cell = this->cellOfNode[level][id];
+            PriorityQueue *neighbors = node->getNeighbors();
+            for (j = 0; j < neighbors->getNodeCount(); j++) {
+                Node *neighbor = neighbors->getNodeAtIndex(j);
+                if (isGraphNode(graph, neighbor) && this->cellOfNode[level][neighbor->getNodeID()] != cell) {
+                    onBoundary[id] = 1;
+                    onBoundary[neighbor->getNodeID()] = 1;
+                }
+            }
+        }
+        for (id = 0; id < nodeCount; id++) {
+            if (onBoundary[id]) {
+                uint32_t cell = this->cellOfNode[level][id];
+                this->boundaryIndex[level][id] = (int32_t)this->cells[level][cell].boundary.size();
+                this->cells[level][cell].boundary.push_back((uint32_t)id);
+            }
+        }
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to compute the boundary clique of one cell
+ ** Runs a Dijkstra search from every boundary node of the
+ ** cell that never leaves the cell. Level 0 searches the
+ ** original edges; higher levels search the cliques and cut
+ ** edges of the level below, which must be customized first
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::customizeCell(OverlayMetric *next, int level, int cell) const {
+    ATLAS_TRACE_SCOPE("PartitionOverlay::customizeCell");
+    typedef std::pair<float, uint32_t> open_entry_t;
+    const std::vector<uint32_t> &boundary = this->cells[level][cell].boundary;
+    const GraphSnapshot *snapshot = next->snapshot.get();
+    size_t boundaryCount = boundary.size();
+    std::vector<float> &clique = next->cliques[level][cell];
+    size_t source;
+    int j;
+
+    clique.assign(boundaryCount * boundaryCount, INFINITY);
+
+    for (source = 0; source < boundaryCount; source++) {
+        std::priority_queue<open_entry_t, std::vector<open_entry_t>, std::greater<open_entry_t> > queue;
+        std::unordered_map<uint32_t, float> pathLengths;
+        pathLengths[boundary[source]] = 0;
+        queue.push(open_entry_t(0, boundary[source]));
+
+        while (!queue.empty()) {
+            open_entry_t top = queue.top();
+            queue.pop();
+            uint32_t id = top.second;
+            if (top.first > pathLengths[id]) {
+                continue;
+            }
+            if (this->boundaryIndex[level][id] >= 0) {
+                clique[source * boundaryCount + this->boundaryIndex[level][id]] = top.first;
+            }
+
+            Node *node = this->graph->getNodeAtIndex(id);
+            PriorityQueue *neighbors = node->getNeighbors();
+            uint32_t subcell = level > 0 ? this->cellOfNode[level - 1][id] : (uint32_t)cell;
+
+            //
+            // Original edges inside the cell; above level 0 only
+            // the ones that cross between subcells
+            //
+
+            for (j = 0; j < neighbors->getNodeCount(); j++) {
+                Node *neighbor = neighbors->getNodeAtIndex(j);
+                if (!isGraphNode(this->graph, neighbor)) {
+                    continue;
+                }
+                uint32_t neighborID = neighbor->getNodeID();
+                if (neighborID >= this->cellOfNode[level].size() ||
+                    this->cellOfNode[level][neighborID] != (uint32_t)cell) {
+                    continue; // Added since build, or outside the cell
+                }
+                if (level > 0 && this->cellOfNode[level - 1][neighborID] == subcell) {
+                    continue;
+                }
+                float cost = getOverlayEdgeCost(snapshot, node, neighbor);
+                if (cost == INFINITY) {
+                    continue;
+                }
+                float nextLength = top.first + cost;
+                std::unordered_map<uint32_t, float>::iterator known = pathLengths.find(neighborID);
+                if (known == pathLengths.end() || nextLength < known->second) {
+                    pathLengths[neighborID] = nextLength;
+                    queue.push(open_entry_t(nextLength, neighborID));
+                }
+            }
+
+            if (level == 0 || this->boundaryIndex[level - 1][id] < 0) {
+                continue;
+            }
+
+            //
+            // Shortcuts across the subcell
+            //
+
+            const std::vector<uint32_t> &subBoundary = this->cells[level - 1][subcell].boundary;
+            const std::vector<float> &subClique = next->cliques[level - 1][subcell];
+            size_t row = (size_t)this->boundaryIndex[level - 1][id] * subBoundary.size();
+            size_t k;
+            for (k = 0; k < subBoundary.size(); k++) {
+                float cost = subClique[row + k];
+                if (cost == INFINITY || subBoundary[k] == id) {
+                    continue;
+                }
+                float nextLength = top.first + cost;
+                std::unordered_map<uint32_t, float>::iterator known = pathLengths.find(subBoundary[k]);
+                if (known == pathLengths.end() || nextLength < known->second) {
+                    pathLengths[subBoundary[k]] = nextLength;
+                    queue.push(open_entry_t(nextLength, subBoundary[k]));
+                }
+            }
+        }
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to customize the overlay for a set of costs
+ ** Arguments are the snapshot supplying edge costs (NULL
+ ** for plain edge lengths) and the number of threads
+ ** Levels are processed bottom up; the cells of a level are
+ ** shared out between the threads. The result replaces the
+ ** previous customization atomically
+ ** Special Return Codes:
+ **       -2: Indicates the overlay has not been built
+ **       -4: Indicates the graph changed structurally since
+ **           build; build the overlay again
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::customize(std::shared_ptr<const GraphSnapshot> snapshot, int threadCount) {
+    ATLAS_TRACE_SCOPE("PartitionOverlay::customize");
+    if (this->graph == (const Graph *)NULL) {
+        return -2;
+    }
+    GraphSearchScope search(this->graph);
+    if (this->isStale()) {
+        return -4;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+
+    std::shared_ptr<OverlayMetric> next(new OverlayMetric());
+    next->snapshot = snapshot;
+    next->cliques.resize(this->levelCount);
+
+    int level, i;
+    for (level = 0; level < this->levelCount; level++) {
+        int cellCount = (int)this->cells[level].size();
+        next->cliques[level].resize(cellCount);
+
+        std::atomic<int> nextCell(0);
+        auto worker = [this, &next, &nextCell, level, cellCount]() {
+            int cell;
+            while ((cell = nextCell.fetch_add(1)) < cellCount) {
+                this->customizeCell(next.get(), level, cell);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (i = 1; i < threadCount; i++) {
+            threads.push_back(std::thread(worker));
+        }
+        worker();
+        for (i = 0; i < (int)threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+
+    std::atomic_store(&this->metric, std::shared_ptr<const OverlayMetric>(next));
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to check whether the graph changed structurally
+ ** since the overlay was built
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::isStale() const {
+    return this->graph->getNodeCount() != this->nodeCount ||
+           this->graph->getStructureVersion() != this->structureVersion;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to find the level a query relaxes a node on
+ ** The highest level on which the node shares a cell with
+ ** neither the start nor the goal; -1 means the node is in
+ ** the level 0 cell of one of them
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::getQueryLevel(uint32_t nodeID, uint32_t startID, uint32_t goalID) const {
+    int level;
+    for (level = this->levelCount - 1; level >= 0; level--) {
+        uint32_t cell = this->cellOfNode[level][nodeID];
+        if (cell != this->cellOfNode[level][startID] && cell != this->cellOfNode[level][goalID]) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to find the shortest distance between two nodes
+ ** Arguments are the start and goal node and the output
+ ** distance, which is INFINITY when there is no path
+ ** A Dijkstra search over the original edges near the start
+ ** and goal and over the highest level cliques elsewhere
+ ** Special Return Codes:
+ **       -1: Indicates no path exists
+ **       -2: Indicates the overlay has not been customized
+ **       -3: Indicates a node outside the partitioned graph
+ **       -4: Indicates the graph changed structurally since
+ **           build; build the overlay again
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::query(Node *startNode, Node *goalNode, float *distance) const {
+    ATLAS_TRACE_SCOPE("PartitionOverlay::query");
+    if (startNode == (Node *)NULL || goalNode == (Node *)NULL || distance == (float *)NULL) {
+        return NULL_ARG;
+    }
+    *distance = INFINITY;
+
+    std::shared_ptr<const OverlayMetric> current = std::atomic_load(&this->metric);
+    if (!current) {
+        return -2;
+    }
+    GraphSearchScope search(this->graph);
+    if (this->isStale()) {
+        return -4;
+    }
+    if (!isGraphNode(this->graph, startNode) || !isGraphNode(this->graph, goalNode)) {
+        return -3;
+    }
+    if (!startNode->mayReach(goalNode)) {
+        return -1;
+    }
+
+    typedef std::pair<float, uint32_t> open_entry_t;
+    const GraphSnapshot *snapshot = current->snapshot.get();
+    uint32_t startID = startNode->getNodeID();
+    uint32_t goalID = goalNode->getNodeID();
+    std::priority_queue<open_entry_t, std::vector<open_entry_t>, std::greater<open_entry_t> > queue;
+    std::unordered_map<uint32_t, float> pathLengths;
+    int j;
+
+    pathLengths[startID] = 0;
+    queue.push(open_entry_t(0, startID));
+
+    while (!queue.empty()) {
+        open_entry_t top = queue.top();
+        queue.pop();
+        uint32_t id = top.second;
+        if (top.first > pathLengths[id]) {
+            continue;
+        }
+        if (id == goalID) {
+            *distance = top.first;
+            return SUCCESS;
+        }
+
+        int level = this->getQueryLevel(id, startID, goalID);
+        if (level >= 0 && this->boundaryIndex[level][id] < 0) {
+            level = -1; // Not a way into the cell, search it edge by edge
+        }
+        Node *node = this->graph->getNodeAtIndex(id);
+        PriorityQueue *neighbors = node->getNeighbors();
+        uint32_t cell = level >= 0 ? this->cellOfNode[level][id] : 0;
+
+        //
+        // Original edges; on an overlay level only the ones
+        // that leave the cell
+        //
+
+        for (j = 0; j < neighbors->getNodeCount(); j++) {
+            Node *neighbor = neighbors->getNodeAtIndex(j);
+            if (!isGraphNode(this->graph, neighbor)) {
+                continue;
+            }
+            uint32_t neighborID = neighbor->getNodeID();
+            if (neighborID >= this->cellOfNode[0].size()) {
+                continue; // Added since build
+            }
+            if (level >= 0 && this->cellOfNode[level][neighborID] == cell) {
+                continue;
+            }
+            float cost = getOverlayEdgeCost(snapshot, node, neighbor);
+            if (cost == INFINITY) {
+                continue;
+            }
+            float nextLength = top.first + cost;
+            std::unordered_map<uint32_t, float>::iterator known = pathLengths.find(neighborID);
+            if (known == pathLengths.end() || nextLength < known->second) {
+                pathLengths[neighborID] = nextLength;
+                queue.push(open_entry_t(nextLength, neighborID));
+            }
+        }
+
+        if (level < 0) {
+            continue;
+        }
+
+        //
+        // Shortcuts across the cell
+        //
+
+        const std::vector<uint32_t> &boundary = this->cells[level][cell].boundary;
+        const std::vector<float> &clique = current->cliques[level][cell];
+        size_t row = (size_t)this->boundaryIndex[level][id] * boundary.size();
+        size_t k;
+        for (k = 0; k < boundary.size(); k++) {
+            float cost = clique[row + k];
+            if (cost == INFINITY || boundary[k] == id) {
+                continue;
+            }
+            float nextLength = top.first + cost;
+            std::unordered_map<uint32_t, float>::iterator known = pathLengths.find(boundary[k]);
+            if (known == pathLengths.end() || nextLength < known->second) {
+                pathLengths[boundary[k]] = nextLength;
+                queue.push(open_entry_t(nextLength, boundary[k]));
+            }
+        }
+    }
+
+    return -1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Statistics accessors for PartitionOverlay
+ ** OUT_OF_BOUNDS is returned for a level that does not exist
+ ************************************************************
+ ************************************************************/
+
+int PartitionOverlay::getCellCount(int level) const {
+    if (level < 0 || level >= this->levelCount) {
+        return OUT_OF_BOUNDS;
+    }
+    return (int)this->cells[level].size();
+}
+
+int PartitionOverlay::getBoundaryCount(int level) const {
+    if (level < 0 || level >= this->levelCount) {
+        return OUT_OF_BOUNDS;
+    }
+    size_t count = 0;
+    size_t cell;
+    for (cell = 0; cell < this->cells[level].size(); cell++) {
+        count += this->cells[level][cell].boundary.size();
+    }
+    return (int)count;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the snapshot version of the current
+ ** customization; 0 if it used plain edge lengths or the
+ ** overlay has not been customized
+ ************************************************************
+ ************************************************************/
+
+unsigned long PartitionOverlay::getMetricVersion() const {
+    std::shared_ptr<const OverlayMetric> current = std::atomic_load(&this->metric);
+    if (!current || !current->snapshot) {
+        return 0;
+    }
+    return current->snapshot->getVersion();
+}
+
+#ifdef ATLAS_TRACE
+/***********************************************************
+ ************************************************************
+ ** Per-thread state of the Tracer
+ ** Only the owning thread touches it while tracing; the
+ ** registry lock is held to register a thread and while
+ ** the Tracer reads or resets every thread
+ ************************************************************
+ ************************************************************/
+
+#define TRACE_PATH_SLOTS (2 * TRACE_MAX_PATHS) // Open addressing, power of two
+#define TRACE_NO_PATH (-2)                    // Call stack not totalled
+#define TRACE_EVENT_CHUNK (16384)             // Events per buffer chunk, power of two
+
+typedef struct
+{
+    int32_t nameID;
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint64_t counters[3];   // Cycles, cache misses, branch misses
+} trace_event_t;
+
+typedef struct
+{
+    int32_t parent;         // Path of the caller, -1 at the root
+    int32_t nameID;
+    uint64_t weights[4];    // Self time and self counters, by TRACE_* weight
+} trace_path_t;
+
+typedef struct
+{
+    int32_t nameID;
+    int32_t pathID;
+    int countersRead;
+    uint64_t weight;        // Sample period the scope stands for, 1 if not sampled
+    uint64_t startNs;
+    uint64_t startCounters[3];
+    uint64_t childNs;
+    uint64_t childCounters[3];
+} trace_frame_t;
+
+struct ThreadTrace
+{
+    unsigned int threadIndex;
+    int counterState;       // 0 untried, 1 open, -1 unavailable
+    int counterFds[3];
+#if defined(__linux__)
+    struct perf_event_mmap_page *counterPages[3]; // For rdpmc, NULL if not mapped
+#endif
+    int sampleCountdown;    // Iterations until the next sample
+    int depth;
+    int overflowDepth;      // Open scopes past TRACE_MAX_DEPTH
+    trace_frame_t frames[TRACE_MAX_DEPTH];
+    int32_t pathCount;
+    trace_path_t paths[TRACE_MAX_PATHS];
+    int32_t pathSlots[TRACE_PATH_SLOTS];
+    std::vector<std::unique_ptr<trace_event_t[]> > eventChunks; // Never moved once written; kept by reset
+    size_t eventCount;
+    size_t droppedCount;
+};
+
+struct ThreadTraceHolder
+{
+    std::shared_ptr<ThreadTrace> trace;
+    ~ThreadTraceHolder();
+};
+
+static std::mutex traceRegistryLock;
+static std::vector<std::shared_ptr<ThreadTrace> > traceRegistry;
+static const char *traceNames[TRACE_MAX_NAMES];
+static int traceNameCount = 0;
+static std::atomic<int> traceCountersEnabled(0);
+static std::atomic<size_t> traceEventLimit(1000000);
+static std::atomic<int> traceSamplePeriod(TRACE_SAMPLE_PERIOD);
+static thread_local ThreadTrace *currentTrace = (ThreadTrace *)NULL;
+static thread_local ThreadTraceHolder threadTrace;
+
+static inline uint64_t getTraceTime() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Functions to open, read and close the hardware counters
+ ** of the calling thread; a no-op outside Linux
+ ** Counters are read in user space with rdpmc when the
+ ** kernel allows it and with one read of the group
+ ** otherwise, or always in TRACE_COUNTERS_READ mode
+ ************************************************************
+ ************************************************************/
+
+#if defined(__linux__)
+static int openTraceCounter(uint64_t config, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+static void closeTraceCounters(ThreadTrace *trace) {
+    int i;
+    for (i = 0; i < 3; i++) {
+        if (trace->counterPages[i] != (struct perf_event_mmap_page *)NULL) {
+            munmap(trace->counterPages[i], (size_t)sysconf(_SC_PAGESIZE));
+            trace->counterPages[i] = (struct perf_event_mmap_page *)NULL;
+        }
+        if (trace->counterFds[i] >= 0) {
+            close(trace->counterFds[i]);
+            trace->counterFds[i] = -1;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static int readUserCounter(const struct perf_event_mmap_page *page, uint64_t *value) {
+    const volatile struct perf_event_mmap_page *volatilePage = page;
+    uint32_t sequence;
+    uint64_t count;
+    do {
+        sequence = volatilePage->lock;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        uint32_t index = volatilePage->index;
+        if (!volatilePage->cap_user_rdpmc || index == 0) {
+            return -1; // Not scheduled on a hardware counter right now
+        }
+        uint32_t low, high;
+        __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+        int shift = 64 - volatilePage->pmc_width;
+        int64_t counter = (int64_t)(((uint64_t)high << 32) | low);
+        counter = (int64_t)((uint64_t)counter << shift) >> shift;
+        count = (uint64_t)(volatilePage->offset + counter);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    } while (volatilePage->lock != sequence);
+    *value = count;
+    return SUCCESS;
+}
+#endif
+#endif
+
+static int openTraceCounters(ThreadTrace *trace) {
+    if (trace->counterState != 0) {
+        return trace->counterState == 1 ? SUCCESS : -1;
+    }
+    trace->counterState = -1;
+#if defined(__linux__)
+    static const uint64_t configs[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES,
+                                        PERF_COUNT_HW_BRANCH_MISSES};
+    int i;
+    for (i = 0; i < 3; i++) {
+        trace->counterFds[i] = openTraceCounter(configs[i], i == 0 ? -1 : trace->counterFds[0]);
+        if (trace->counterFds[i] < 0) {
+            closeTraceCounters(trace);
+            return -1;
+        }
+        void *page = mmap(NULL, (size_t)sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, trace->counterFds[i], 0);
+        if (page != MAP_FAILED) {
+            trace->counterPages[i] = (struct perf_event_mmap_page *)page;
+        }
+    }
+    trace->counterState = 1;
+    return SUCCESS;
+#else
+    return -1;
+#endif
+}
+
+static int readTraceCounters(ThreadTrace *trace, uint64_t *counters) {
+    int mode = traceCountersEnabled.load(std::memory_order_relaxed);
+    if (mode == TRACE_COUNTERS_OFF || openTraceCounters(trace) != SUCCESS) {
+        counters[0] = counters[1] = counters[2] = 0;
+        return 0;
+    }
+#if defined(__linux__)
+#if defined(__x86_64__) || defined(__i386__)
+    if (mode == TRACE_COUNTERS_ON &&
+        trace->counterPages[0] != (struct perf_event_mmap_page *)NULL &&
+        trace->counterPages[1] != (struct perf_event_mmap_page *)NULL &&
+        trace->counterPages[2] != (struct perf_event_mmap_page *)NULL &&
+        readUserCounter(trace->counterPages[0], &counters[0]) == SUCCESS &&
+        readUserCounter(trace->counterPages[1], &counters[1]) == SUCCESS &&
+        readUserCounter(trace->counterPages[2], &counters[2]) == SUCCESS) {
+        return 1;
+    }
+#endif
+    struct
+    {
+        uint64_t count;
+        uint64_t values[3];
+    } group;
+    if (read(trace->counterFds[0], &group, sizeof(group)) == (ssize_t)sizeof(group)) {
+        counters[0] = group.values[0];
+        counters[1] = group.values[1];
+        counters[2] = group.values[2];
+        return 1;
+    }
+#endif
+    counters[0] = counters[1] = counters[2] = 0;
+    return 0;
+}
+
+ThreadTraceHolder::~ThreadTraceHolder() {
+#if defined(__linux__)
+    if (this->trace) {
+        closeTraceCounters(this->trace.get());
+        this->trace->counterState = -1;
+    }
+#endif
+    currentTrace = (ThreadTrace *)NULL;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to get the trace state of the calling thread
+ ** Registers the thread with the Tracer on first use
+ ************************************************************
+ ************************************************************/
+
+static ThreadTrace *registerThreadTrace() {
+    std::shared_ptr<ThreadTrace> trace(new ThreadTrace());
+    int i;
+    trace->counterState = 0;
+    for (i = 0; i < 3; i++) {
+        trace->counterFds[i] = -1;
+#if defined(__linux__)
+        trace->counterPages[i] = (struct perf_event_mmap_page *)NULL;
+#endif
+    }
+    trace->sampleCountdown = 1;
+    trace->depth = 0;
+    trace->overflowDepth = 0;
+    trace->pathCount = 0;
+    std::fill(trace->pathSlots, trace->pathSlots + TRACE_PATH_SLOTS, -1);
+    trace->eventCount = 0;
+    trace->droppedCount = 0;
+
+    std::lock_guard<std::mutex> guard(traceRegistryLock);
+    trace->threadIndex = (unsigned int)traceRegistry.size();
+    traceRegistry.push_back(trace);
+    threadTrace.trace = trace;
+    currentTrace = trace.get();
+    return currentTrace;
+}
+
+static inline ThreadTrace *getThreadTrace() {
+    ThreadTrace *trace = currentTrace;
+    if (trace == (ThreadTrace *)NULL) {
+        trace = registerThreadTrace();
+    }
+    return trace;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to find the call stack of a scope
+ ** A call stack is its caller's path plus the scope name;
+ ** new ones are added to the fixed table of the thread
+ ** Returns TRACE_NO_PATH once the table is full
+ ************************************************************
+ ************************************************************/
+
+static int32_t getTracePath(ThreadTrace *trace, int32_t parent, int32_t nameID) {
+    if (parent == TRACE_NO_PATH) {
+        return TRACE_NO_PATH;
+    }
+    uint32_t hash = ((uint32_t)(parent + 1) * 2654435761u) ^ ((uint32_t)nameID * 40503u);
+    uint32_t slot = hash & (TRACE_PATH_SLOTS - 1);
+    while (trace->pathSlots[slot] >= 0) {
+        const trace_path_t &path = trace->paths[trace->pathSlots[slot]];
+        if (path.parent == parent && path.nameID == nameID) {
+            return trace->pathSlots[slot];
+        }
+        slot = (slot + 1) & (TRACE_PATH_SLOTS - 1);
+    }
+    if (trace->pathCount == TRACE_MAX_PATHS) {
+        return TRACE_NO_PATH;
+    }
+
+    int32_t pathID = trace->pathCount++;
+    trace_path_t &path = trace->paths[pathID];
+    path.parent = parent;
+    path.nameID = nameID;
+    path.weights[0] = path.weights[1] = path.weights[2] = path.weights[3] = 0;
+    trace->pathSlots[slot] = pathID;
+    return pathID;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to open the frame of a recorded TraceScope
+ ** The clock is read last so the bookkeeping is not charged
+ ** to the scope
+ ** Arguments are the name and the weight of the scope
+ ************************************************************
+ ************************************************************/
+
+void TraceScope::open(int nameID, int weight) {
+    ThreadTrace *trace = getThreadTrace();
+    if (trace->depth == TRACE_MAX_DEPTH) {
+        trace->overflowDepth++;
+        return;
+    }
+    int32_t parent = trace->depth > 0 ? trace->frames[trace->depth - 1].pathID : -1;
+    trace_frame_t &frame = trace->frames[trace->depth++];
+    frame.nameID = nameID;
+    frame.pathID = getTracePath(trace, parent, nameID);
+    frame.weight = (uint64_t)weight;
+    frame.childNs = 0;
+    frame.childCounters[0] = frame.childCounters[1] = frame.childCounters[2] = 0;
+    frame.countersRead = readTraceCounters(trace, frame.startCounters);
+    frame.startNs = getTraceTime();
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to close the frame of a recorded TraceScope
+ ** Records it as an event (while under the event limit) and
+ ** adds its self cost, times its weight, to the total of
+ ** its call stack. The weighted cost of a sampled child can
+ ** exceed what its parent measured; self costs stop at 0
+ ************************************************************
+ ************************************************************/
+
+void TraceScope::close() {
+    uint64_t endNs = getTraceTime();
+    ThreadTrace *trace = getThreadTrace();
+    if (trace->overflowDepth > 0) {
+        trace->overflowDepth--;
+        return;
+    }
+
+    trace_frame_t &frame = trace->frames[--trace->depth];
+    trace_event_t event;
+    int i;
+    event.nameID = frame.nameID;
+    event.startNs = frame.startNs;
+    event.durationNs = endNs - frame.startNs;
+    event.counters[0] = event.counters[1] = event.counters[2] = 0;
+    if (frame.countersRead) {
+        uint64_t endCounters[3];
+        if (readTraceCounters(trace, endCounters)) {
+            for (i = 0; i < 3; i++) {
+                event.counters[i] = endCounters[i] - frame.startCounters[i];
+            }
+        }
+    }
+
+    if (trace->eventCount < traceEventLimit.load(std::memory_order_relaxed)) {
+        size_t chunk = trace->eventCount / TRACE_EVENT_CHUNK;
+        if (chunk == trace->eventChunks.size()) {
+            trace->eventChunks.push_back(std::unique_ptr<trace_event_t[]>(new trace_event_t[TRACE_EVENT_CHUNK]));
+        }
+        trace->eventChunks[chunk][trace->eventCount % TRACE_EVENT_CHUNK] = event;
+        trace->eventCount++;
+    }
+    else {
+        trace->droppedCount++;
+    }
+    if (frame.pathID >= 0) {
+        trace_path_t &path = trace->paths[frame.pathID];
+        if (event.durationNs > frame.childNs) {
+            path.weights[TRACE_TIME] += (event.durationNs - frame.childNs) * frame.weight;
+        }
+        for (i = 0; i < 3; i++) {
+            if (event.counters[i] > frame.childCounters[i]) {
+                path.weights[TRACE_CYCLES + i] += (event.counters[i] - frame.childCounters[i]) * frame.weight;
+            }
+        }
+    }
+
+    if (trace->depth > 0) {
+        trace_frame_t &parent = trace->frames[trace->depth - 1];
+        parent.childNs += event.durationNs * frame.weight;
+        for (i = 0; i < 3; i++) {
+            parent.childCounters[i] += event.counters[i] * frame.weight;
+        }
+    }
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to intern a scope name
+ ** Called once per ATLAS_TRACE_SCOPE site; the name must
+ ** outlive the trace, e.g. a string literal
+ ** Returns the ID of the name; once TRACE_MAX_NAMES names
+ ** are in use, new names share the last one
+ ************************************************************
+ ************************************************************/
+
+int Tracer::internName(const char *name) {
+    if (name == (const char *)NULL) {
+        name = "(null)";
+    }
+    std::lock_guard<std::mutex> guard(traceRegistryLock);
+    int i;
+    for (i = 0; i < traceNameCount; i++) {
+        if (strcmp(traceNames[i], name) == 0) {
+            return i;
+        }
+    }
+    if (traceNameCount == TRACE_MAX_NAMES) {
+        traceNames[TRACE_MAX_NAMES - 1] = "(other)";
+        return TRACE_MAX_NAMES - 1;
+    }
+    traceNames[traceNameCount] = name;
+    return traceNameCount++;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to turn hardware counters on or off
+ ** Counters are opened per thread on first use
+ ** Argument is TRACE_COUNTERS_OFF, TRACE_COUNTERS_ON or
+ ** TRACE_COUNTERS_READ, which skips rdpmc (e.g. to compare
+ ** the two ways of reading)
+ ** Special Return Codes:
+ **       -1: Indicates counters are unavailable on this
+ **           system (not Linux, or perf_event is not
+ **           permitted); tracing continues without them
+ ************************************************************
+ ************************************************************/
+
+int Tracer::enableCounters(int mode) {
+    if (mode < TRACE_COUNTERS_OFF || mode > TRACE_COUNTERS_READ) {
+        return OUT_OF_BOUNDS;
+    }
+    if (mode == TRACE_COUNTERS_OFF) {
+        traceCountersEnabled.store(TRACE_COUNTERS_OFF);
+        return SUCCESS;
+    }
+    if (openTraceCounters(getThreadTrace()) != SUCCESS) {
+        traceCountersEnabled.store(TRACE_COUNTERS_OFF);
+        return -1;
+    }
+    traceCountersEnabled.store(mode);
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to set how many events each thread keeps for
+ ** the Chrome trace; later events are only counted as
+ ** dropped. Folded stack totals are always kept
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Tracer::setEventLimit(size_t limit) {
+    traceEventLimit.store(limit);
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to set how often ATLAS_TRACE_SAMPLE picks an
+ ** iteration; 1 records every iteration
+ ** Special Return Codes:
+ **       OUT_OF_BOUNDS: Indicates a period below 1
+ ************************************************************
+ ************************************************************/
+
+int Tracer::setSamplePeriod(int period) {
+    if (period < 1) {
+        return OUT_OF_BOUNDS;
+    }
+    traceSamplePeriod.store(period);
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to decide whether the calling thread records
+ ** its next iteration; use through ATLAS_TRACE_SAMPLE
+ ** Every thread records the first of each run of
+ ** sample-period iterations
+ ** Returns the weight of the iteration's sampled scopes:
+ ** the sample period, or 0 to skip them
+ ************************************************************
+ ************************************************************/
+
+int Tracer::sample() {
+    ThreadTrace *trace = getThreadTrace();
+    if (--trace->sampleCountdown > 0) {
+        return 0;
+    }
+    trace->sampleCountdown = traceSamplePeriod.load(std::memory_order_relaxed);
+    return trace->sampleCountdown;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to discard everything recorded so far
+ ** Call stacks stay in the tables with their totals cleared
+ ** No Special Return Codes
+ ************************************************************
+ ************************************************************/
+
+int Tracer::reset() {
+    std::lock_guard<std::mutex> guard(traceRegistryLock);
+    size_t i;
+    int32_t j;
+    for (i = 0; i < traceRegistry.size(); i++) {
+        ThreadTrace *trace = traceRegistry[i].get();
+        trace->sampleCountdown = 1;
+        trace->eventCount = 0;
+        trace->droppedCount = 0;
+        for (j = 0; j < trace->pathCount; j++) {
+            std::fill(trace->paths[j].weights, trace->paths[j].weights + 4, 0);
+        }
+    }
+    return SUCCESS;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to write the recorded events as a Chrome trace
+ ** The JSON file opens in chrome://tracing or Perfetto;
+ ** counters appear as arguments of each event
+ ** Argument is the path of the file to be written
+ ** Special Return Codes:
+ **       -1: Indicates the file could not be written
+ ************************************************************
+ ************************************************************/
+
+int Tracer::writeChromeTrace(const char *path) {
+    if (path == (const char *)NULL) {
+        return NULL_ARG;
+    }
+    FILE *file = fopen(path, "w");
+    if (file == (FILE *)NULL) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> guard(traceRegistryLock);
+    const char *separator = "";
+    size_t i, j;
+    fprintf(file, "{\"traceEvents\":[");
+    for (i = 0; i < traceRegistry.size(); i++) {
+        const ThreadTrace *trace = traceRegistry[i].get();
+        for (j = 0; j < trace->eventCount; j++) {
+            const trace_event_t &event = trace->eventChunks[j / TRACE_EVENT_CHUNK][j % TRACE_EVENT_CHUNK];
+            fprintf(file,
+                    "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"cycles\":%llu,\"cache_misses\":%llu,\"branch_misses\":%llu}}",
+                    separator, traceNames[event.nameID], trace->threadIndex,
+                    event.startNs / 1000.0, event.durationNs / 1000.0,
+                    (unsigned long long)event.counters[0], (unsigned long long)event.counters[1],
+                    (unsigned long long)event.counters[2]);
+            separator = ",";
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    return fclose(file) == 0 ? SUCCESS : -1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Function to write the totals as folded stacks
+ ** One "caller;callee weight" line per call stack, merged
+ ** over all threads, as read by flamegraph.pl and speedscope
+ ** Arguments are the path of the file to be written and the
+ ** weight: TRACE_TIME (self nanoseconds), TRACE_CYCLES,
+ ** TRACE_CACHE_MISSES or TRACE_BRANCH_MISSES
+ ** Special Return Codes:
+ **       -1: Indicates the file could not be written
+ ************************************************************
+ ************************************************************/
+
+int Tracer::writeFoldedStacks(const char *path, int weight) {
+    if (path == (const char *)NULL) {
+        return NULL_ARG;
+    }
+    if (weight < TRACE_TIME || weight > TRACE_BRANCH_MISSES) {
+        return OUT_OF_BOUNDS;
+    }
+
+    std::map<std::string, uint64_t> merged;
+    {
+        std::lock_guard<std::mutex> guard(traceRegistryLock);
+        std::vector<std::string> stacks;
+        size_t i;
+        int32_t j;
+        for (i = 0; i < traceRegistry.size(); i++) {
+            const ThreadTrace *trace = traceRegistry[i].get();
+            stacks.resize(trace->pathCount);
+            for (j = 0; j < trace->pathCount; j++) {
+                const trace_path_t &tracePath = trace->paths[j];
+                stacks[j] = tracePath.parent >= 0 ? stacks[tracePath.parent] + ";" : std::string();
+                stacks[j] += traceNames[tracePath.nameID]; // Callers are always added first
+                if (tracePath.weights[weight] > 0) {
+                    merged[stacks[j]] += tracePath.weights[weight];
+                }
+            }
+        }
+    }
+
+    FILE *file = fopen(path, "w");
+    if (file == (FILE *)NULL) {
+        return -1;
+    }
+    std::map<std::string, uint64_t>::const_iterator line;
+    for (line = merged.begin(); line != merged.end(); ++line) {
+        fprintf(file, "%s %llu\n", line->first.c_str(), (unsigned long long)line->second);
+    }
+    return fclose(file) == 0 ? SUCCESS : -1;
+}
+
+/***********************************************************
+ ************************************************************
+ ** Functions to count the events kept and dropped over
+ ** all threads
+ ************************************************************
+ ************************************************************/
+
+size_t Tracer::getEventCount() {
+    std::lock_guard<std::mutex> guard(traceRegistryLock);
+    size_t count = 0;
+    size_t i;
+    for (i = 0; i < traceRegistry.size(); i++) {
+        count += traceRegistry[i]->eventCount;
+    }
+    return count;
+}
+
+size_t Tracer::getDroppedCount() {
+    std::lock_guard<std::mutex> guard(traceRegistryLock);
+    size_t count = 0;
+    size_t i;
+    for (i = 0; i < traceRegistry.size(); i++) {
+        count += traceRegistry[i]->droppedCount;
+    }
+    return count;
+}
+#endif
 }
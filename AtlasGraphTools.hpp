@@ -8,9 +8,25 @@
  ************************************************************/
 
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <iomanip>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <stdio.h>
+#include <stdint.h>
 
 #include <math.h>
 
@@ -49,6 +65,56 @@ typedef struct
 #define NULL_ARG (-127) // Indicates a null pointer was passed
 // as a function arg
 #define OUT_OF_BOUNDS (-255) // Indicates out of bounds indexing
+#define SEARCH_CANCELLED (-63) // Indicates a search was cancelled
+#define BUDGET_EXCEEDED (-31)  // Indicates a search ran out of
+// expansions or time
+
+/************************************************************
+ ************************************************************
+ ** Tracing for AtlasGraphTools
+ ** Build with -DATLAS_TRACE to record a timed scope for each
+ ** ATLAS_TRACE_SCOPE; without it the macro expands to nothing
+ ** Each site interns its name once, so a scope only carries
+ ** a small integer at run time
+ ** Scopes inside hot loops use ATLAS_TRACE_SAMPLED_SCOPE:
+ ** ATLAS_TRACE_SAMPLE at the top of each iteration picks one
+ ** iteration in every sample period, only that iteration's
+ ** sampled scopes are recorded, and their totals are scaled
+ ** by the period
+ ************************************************************
+ ************************************************************/
+
+#ifdef ATLAS_TRACE
+#define ATLAS_TRACE_CONCAT2(a, b) a##b
+#define ATLAS_TRACE_CONCAT(a, b) ATLAS_TRACE_CONCAT2(a, b)
+#define ATLAS_TRACE_SCOPE(name) \
+    static const int ATLAS_TRACE_CONCAT(atlasTraceName, __LINE__) = Atlas::Tracer::internName(name); \
+    Atlas::TraceScope ATLAS_TRACE_CONCAT(atlasTraceScope, __LINE__)(ATLAS_TRACE_CONCAT(atlasTraceName, __LINE__))
+#define ATLAS_TRACE_SAMPLE() \
+    const int atlasTraceSampleWeight = Atlas::Tracer::sample()
+#define ATLAS_TRACE_SAMPLED_SCOPE(name) \
+    static const int ATLAS_TRACE_CONCAT(atlasTraceName, __LINE__) = Atlas::Tracer::internName(name); \
+    Atlas::TraceScope ATLAS_TRACE_CONCAT(atlasTraceScope, __LINE__)(ATLAS_TRACE_CONCAT(atlasTraceName, __LINE__), \
+                                                                 atlasTraceSampleWeight)
+#else
+#define ATLAS_TRACE_SCOPE(name)
+#define ATLAS_TRACE_SAMPLE()
+#define ATLAS_TRACE_SAMPLED_SCOPE(name)
+#endif
+
+#define TRACE_TIME (0)          // Folded stack weights for Tracer
+#define TRACE_CYCLES (1)
+#define TRACE_CACHE_MISSES (2)
+#define TRACE_BRANCH_MISSES (3)
+
+#define TRACE_COUNTERS_OFF (0)  // Modes of Tracer::enableCounters
+#define TRACE_COUNTERS_ON (1)   // rdpmc where permitted, else read()
+#define TRACE_COUNTERS_READ (2) // Always read() the counter group
+
+#define TRACE_MAX_NAMES (256)   // Distinct scope names
+#define TRACE_MAX_DEPTH (64)    // Nested scopes recorded per thread
+#define TRACE_MAX_PATHS (4096)  // Distinct call stacks totalled per thread
+#define TRACE_SAMPLE_PERIOD (64) // Default iterations per sample
 
 /************************************************************
  ************************************************************
@@ -58,7 +124,44 @@ typedef struct
 namespace Atlas {
 class Node;
 class PriorityQueue;
+class Graph;
+class GraphSnapshot;
+class EdgeUpdateBatch;
+class PathCache;
+class SearchControl;
+class QueryExecutor;
+class CompressedGraph;
+class PartitionOverlay;
 int AStar(Node* startNode, Node* goalNode);
+int AStar(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path);
+int AStar(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path, PathCache* cache);
+int AStar(Node* startNode, Node* goalNode, const GraphSnapshot* snapshot, std::vector<Node*>* path, PathCache* cache, SearchControl* control);
+int AStar(const CompressedGraph* graph, int startIndex, int goalIndex, std::vector<int>* path);
+
+typedef struct
+{
+    Node* node1;
+    Node* node2;
+    float cost;
+    int reset;
+} edge_update_t; // A single pending change to
+// the cost of an edge
+
+typedef struct
+{
+    uint32_t from;
+    uint32_t to;
+} edge_t; // An edge between two nodes given by their
+// index in the arrays passed to Graph::build
+
+typedef struct
+{
+    int result;               // Return code of the search
+    std::vector<Node*> path;  // Start to goal when result is SUCCESS
+    unsigned long version;    // Snapshot version that was searched
+    long expansions;          // Nodes expanded by the search
+} query_result_t; // Outcome of a query run by a QueryExecutor
+
 /************************************************************
  ************************************************************
  ** Node Class Definition
@@ -71,6 +174,7 @@ int AStar(Node* startNode, Node* goalNode);
 
 class Node  {
     friend int AStar(Node* startNode, Node* goalNode);
+    friend class Graph;
 private:
     point_t location;                     // Specifies the physical location of this node
     unsigned int nodeID;                  // Specifies the index of this node in its parent graph
@@ -79,24 +183,43 @@ private:
     int neighborCount;                    // Number of neighbor connections to this node
     float pathLength;
     Node *previous;
+    int deleted;                          // Set when the node is removed from its graph
+    int directed;                         // Set on the nodes of a directed graph; edges are one-way
+    Node *componentParent;                // Union-find link of the connectivity index
+    int componentRank;
+    int componentStale;                   // Set on a root once an edge in its component is removed
+
+    Node *compressComponent();
+    int unionComponent(Node *node);
+
+    Node(const Node &) = delete;            // Nodes own their neighbor queues
+    Node &operator=(const Node &) = delete;
 
 public:
     //
     // Constructors
     //
     Node(float x, float y);                //Default Constructor for node
+    ~Node();
     //
     // Member Functions
     //
     int isNeighbor(Node *node);      // Checks if node neighbors this
     int addNeighbor(Node *neighbor); //Add a connection to this node
+    int removeNeighbor(Node *neighbor); //Remove a connection from this node
     int resetNeighbors();
+    int mayReach(Node *node) const;  // Checks the connectivity index
+    Node *getComponent() const;      // Representative of this nodes component
 
     point_t getLocation() const
     {                        // Returns the physical location of the node
         return this->location; // Inlined to eliminate function call overhead
     }
 
+    // The returned queue may hold NULL tombstones left by
+    // removals until it is compacted: skip NULL entries when
+    // iterating, and use getLiveCount (or getNeighborCount)
+    // rather than getNodeCount for the number of neighbors
     PriorityQueue* getNeighbors() const
     {                         // Returns the neighbors of the node
         return this->neighbors; // Inlined to eliminate function call overhead
@@ -104,11 +227,30 @@ public:
 
     PriorityQueue* getNeighbors(Node* goalNode);
 
+    int getNeighborCount() const
+    {
+        return this->neighborCount;
+    }
 
     Node *getPrevious() const
     {
         return this->previous;
     }
+
+    int isDeleted() const
+    {
+        return this->deleted;
+    }
+
+    int isDirected() const
+    {
+        return this->directed;
+    }
+
+    unsigned int getNodeID() const
+    {
+        return this->nodeID;
+    }
 };
 
 /************************************************************
@@ -125,24 +267,32 @@ float getNodeDistance(Node *node1, Node *node2);
  ** This class is used to store nodes in a min-last array
  ** Key data include the nodes, the number of nodes, and their
  ** heuristic sizes
+ ** Entries can be tombstoned in place (left as NULL) and
+ ** squeezed out later by compact; getNodeCount includes
+ ** tombstones, getLiveCount does not
  ************************************************************
  ************************************************************/
 
 class PriorityQueue
 {
     friend int AStar(Node* startNode, Node* goalNode);
+    friend class Graph;
 private:
     Node *goalNode;
     std::vector<Node *> nodes;
     std::vector<float> heuristics;
     int count;
+    int tombstoneCount;
 
 public:
     PriorityQueue(Node *goalNode);
     int insert(Node *node, float pathLength);
+    int insertWithHeuristic(Node *node, float heuristic);
     Node *pop();
     int removeNode(Node *node);
     int removeNode(int index);
+    int tombstone(Node *node);
+    int compact();
     int getNodeIndex(Node *node);
     Node* getMin();
     Node* getNodeAtIndex(int index) const;
@@ -150,7 +300,515 @@ public:
     int getNodeCount() const {
         return this->count;
     }
+    int getLiveCount() const {
+        return this->count - this->tombstoneCount;
+    }
+    int getTombstoneCount() const {
+        return this->tombstoneCount;
+    }
+};
+
+/************************************************************
+ ************************************************************
+ ** GraphSnapshot Class Definition
+ ** An immutable, versioned view of the edge costs of a graph
+ ** Costs are stored as an overlay on top of the node
+ ** adjacency; edges without an override cost their length
+ ** Snapshots are only created by Graph::publish and are never
+ ** modified afterwards, so any number of threads may search
+ ** a snapshot while newer versions are being published
+ ** Versions that only change the adjacency share the
+ ** override map of the version before them
+ ************************************************************
+ ************************************************************/
+
+class GraphSnapshot
+{
+    friend class Graph;
+private:
+    typedef std::pair<Node *, Node *> edge_key_t;
+
+    struct EdgeKeyHash
+    {
+        size_t operator()(const edge_key_t &key) const
+        {
+            size_t h1 = std::hash<Node *>()(key.first);
+            size_t h2 = std::hash<Node *>()(key.second);
+            return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
+        }
+    };
+
+    typedef std::unordered_map<edge_key_t, float, EdgeKeyHash> edge_cost_map_t;
+
+    unsigned long version;
+    std::shared_ptr<const edge_cost_map_t> edgeCosts; // Overridden edge costs, shared between versions
+
+    GraphSnapshot(unsigned long version, std::shared_ptr<const edge_cost_map_t> edgeCosts);
+    static edge_key_t makeKey(Node *node1, Node *node2);
+
+public:
+    GraphSnapshot(unsigned long version);
+    float getEdgeCost(Node *node1, Node *node2) const;
+    unsigned long getVersion() const {
+        return this->version;
+    }
+    int getOverrideCount() const {
+        return (int)this->edgeCosts->size();
+    }
+};
+
+/************************************************************
+ ************************************************************
+ ** EdgeUpdateBatch Class Definition
+ ** Collects edge cost changes that are published together
+ ** by Graph::publish. A batch is owned by a single writer
+ ************************************************************
+ ************************************************************/
+
+class EdgeUpdateBatch
+{
+    friend class Graph;
+private:
+    std::vector<edge_update_t> updates;
+
+public:
+    int setEdgeCost(Node *node1, Node *node2, float cost);
+    int closeEdge(Node *node1, Node *node2);
+    int resetEdgeCost(Node *node1, Node *node2);
+    int clear();
+    int getUpdateCount() const {
+        return (int)this->updates.size();
+    }
+};
+
+/************************************************************
+ ************************************************************
+ ** Graph Class Definition
+ ** Owns a set of nodes and publishes versioned snapshots of
+ ** their edge costs
+ ** Writers publish whole batches under a lock; readers take
+ ** the current snapshot without locking and keep a
+ ** consistent view for as long as they hold it
+ ** The node adjacency itself is not versioned; structural
+ ** edits (addNode, build, addEdge, removeEdge, removeNode,
+ ** compact, rebuildComponents) wait until no search is
+ ** running, and searches wait while an edit is pending.
+ ** QueryExecutor workers, PartitionOverlay and
+ ** CompressedGraph::build enter searches themselves; other
+ ** threads searching while edits may happen bracket each
+ ** search with beginSearch and endSearch. Brackets must not
+ ** nest or contain structural edits, which would deadlock
+ ** addEdge, removeEdge, removeNode and compact publish a new
+ ** version afterwards so cached results are invalidated
+ ** Removals leave the connectivity index stale (mayReach
+ ** answers 1 for the affected components) until the next
+ ** compact or an explicit rebuildComponents; edges removed
+ ** with Node::removeNeighbor directly are not tracked, so
+ ** call rebuildComponents after those
+ ************************************************************
+ ************************************************************/
+
+class Graph
+{
+private:
+    std::vector<Node *> nodes;                     // Indexed by nodeID, deleted nodes stay until compact
+    int deletedCount;                              // Number of deleted nodes awaiting compaction
+    int directed;                                  // Set by build for one-way edges
+    int componentsStale;                           // Set by removals, cleared by rebuildComponents
+    std::atomic<unsigned long> structureVersion;   // Counts changes to the nodes and adjacency
+    std::shared_ptr<const GraphSnapshot> snapshot; // Accessed with std::atomic_load/store only
+    std::mutex publishLock;                        // Serializes writers
+    mutable std::mutex structureLock;              // Guards the search and edit counts
+    mutable std::condition_variable structureIdle; // Signalled when searches or edits finish
+    mutable int searchCount;                       // Searches between beginSearch and endSearch
+    int editCount;                                 // Structural edits waiting or running
+    int editing;                                   // Set while a structural edit runs
+
+    class StructureEdit                            // Holds off searches for one structural edit
+    {
+    private:
+        Graph *graph;
+    public:
+        StructureEdit(Graph *graph);
+        ~StructureEdit();
+    };
+
+    int containsNode(const Node *node) const;
+    int advanceVersion();
+    int dropEdgeCost(Node *node1, Node *node2);
+    int relabelComponents();
+
+public:
+    Graph();
+    ~Graph();
+    int addNode(Node *node);
+    int build(const float *x, const float *y, int nodeCount, const edge_t *edges, size_t edgeCount,
+              int directed, int threadCount);
+    int removeNode(Node *node);
+    int addEdge(Node *node1, Node *node2);
+    int removeEdge(Node *node1, Node *node2);
+    int compact();
+    int rebuildComponents();
+    int beginSearch() const;
+    int endSearch() const;
+    Node *getNodeAtIndex(int index) const;
+    int getNodeCount() const {
+        return (int)this->nodes.size();
+    }
+    int getLiveCount() const {
+        return (int)this->nodes.size() - this->deletedCount;
+    }
+    int getDeletedCount() const {
+        return this->deletedCount;
+    }
+    int isDirected() const {
+        return this->directed;
+    }
+    std::shared_ptr<const GraphSnapshot> acquireSnapshot() const;
+    int publish(const EdgeUpdateBatch *batch);
+    unsigned long getVersion() const;
+    unsigned long getStructureVersion() const {
+        return this->structureVersion.load();
+    }
+};
+
+/************************************************************
+ ************************************************************
+ ** PathCache Class Definition
+ ** A bounded, thread-safe LRU cache of search results
+ ** Entries are keyed by start and goal node and remember the
+ ** snapshot version they were computed on; a lookup on any
+ ** other version is a miss, and a newer version evicts the
+ ** stale entry
+ ** Adjacency changes made through the Graph (addEdge,
+ ** removeEdge, removeNode) publish a new version; changes
+ ** made directly on nodes (Node::addNeighbor,
+ ** Node::removeNeighbor) do not, so clear the cache after
+ ** making them
+ ************************************************************
+ ************************************************************/
+
+class PathCache
+{
+private:
+    typedef std::pair<Node *, Node *> query_key_t;
+
+    struct QueryKeyHash
+    {
+        size_t operator()(const query_key_t &key) const
+        {
+            size_t h1 = std::hash<Node *>()(key.first);
+            size_t h2 = std::hash<Node *>()(key.second);
+            return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
+        }
+    };
+
+    typedef struct
+    {
+        query_key_t key;
+        unsigned long version;
+        int result;               // SUCCESS or -1
+        std::vector<Node *> path;
+    } cache_entry_t;
+
+    std::list<cache_entry_t> entries; // Most recently used first
+    std::unordered_map<query_key_t, std::list<cache_entry_t>::iterator, QueryKeyHash> index;
+    size_t capacity;
+    mutable std::mutex lock;
+    unsigned long hitCount;
+    unsigned long missCount;
+    unsigned long evictionCount;      // Entries dropped to make room
+    unsigned long invalidationCount;  // Entries dropped for a newer version
+
+public:
+    PathCache(int capacity);
+    int lookup(Node *startNode, Node *goalNode, unsigned long version, std::vector<Node *> *path);
+    int store(Node *startNode, Node *goalNode, unsigned long version, int result, const std::vector<Node *> *path);
+    int clear();
+    int getEntryCount() const;
+    unsigned long getHitCount() const;
+    unsigned long getMissCount() const;
+    unsigned long getEvictionCount() const;
+    unsigned long getInvalidationCount() const;
+    float getHitRate() const;
+};
+
+/************************************************************
+ ************************************************************
+ ** SearchControl Class Definition
+ ** Cooperative cancellation and budgets for a single search
+ ** The search polls the control once per expanded node and
+ ** stops with SEARCH_CANCELLED or BUDGET_EXCEEDED; cancel
+ ** may be called from any thread at any time
+ ** A budget of 0 is unlimited. The time budget is counted
+ ** from the start of the search
+ ************************************************************
+ ************************************************************/
+
+class SearchControl
+{
+private:
+    std::atomic<int> cancelled;
+    long maxExpansions;
+    long timeBudgetUs;                                  // Microseconds
+    long expansions;                                    // Written by the searching thread only
+    std::chrono::steady_clock::time_point deadline;
+
+public:
+    SearchControl(long maxExpansions, long timeBudgetUs);
+    int begin();
+    int expand();
+    int cancel();
+    int isCancelled() const {
+        return this->cancelled.load(std::memory_order_relaxed);
+    }
+    long getExpansions() const {
+        return this->expansions;
+    }
+};
+
+/************************************************************
+ ************************************************************
+ ** QueryExecutor Class Definition
+ ** Runs snapshot searches on a pool of worker threads
+ ** Queries are answered through a std::future or a callback
+ ** run on the worker thread; each query searches the newest
+ ** snapshot of the graph when a worker picks it up
+ ** Workers bracket each search with Graph::beginSearch, so
+ ** structural edits wait for running queries and queries
+ ** picked up meanwhile wait for the edit; callbacks run
+ ** outside the bracket and may edit the graph
+ ** Shutting down resolves every query still queued as
+ ** SEARCH_CANCELLED, cancels the controls of running ones
+ ** and waits for their callbacks to return
+ ** Callbacks must not call shutdown or destroy the
+ ** executor: the worker would try to join itself, which
+ ** throws std::system_error
+ ************************************************************
+ ************************************************************/
+
+class QueryExecutor
+{
+private:
+    typedef struct
+    {
+        Node *startNode;
+        Node *goalNode;
+        std::shared_ptr<SearchControl> control;
+        std::function<void(const query_result_t &)> callback;
+    } query_task_t;
+
+    Graph *graph;
+    PathCache *cache;
+    std::vector<std::thread> workers;
+    std::deque<query_task_t> tasks;
+    std::vector<std::shared_ptr<SearchControl> > running; // Control of the query each worker runs
+    mutable std::mutex lock;
+    std::condition_variable wake;
+    int stopping;
+
+    void runWorker(int index);
+
+public:
+    QueryExecutor(Graph *graph, int workerCount, PathCache *cache);
+    ~QueryExecutor();
+    std::future<query_result_t> submit(Node *startNode, Node *goalNode, std::shared_ptr<SearchControl> control);
+    int submit(Node *startNode, Node *goalNode, std::shared_ptr<SearchControl> control,
+               std::function<void(const query_result_t &)> callback);
+    int shutdown();
+    int getPendingCount() const;
 };
+
+/************************************************************
+ ************************************************************
+ ** CompressedGraph Class Definition
+ ** A compact, read-only copy of a Graph for searching
+ ** Space is divided into square tiles; node locations are
+ ** stored as 16-bit fixed-point offsets within their tile
+ ** Tiles are numbered along a Z-curve, and so are the
+ ** nodes within each tile, so neighbor lists are stored as
+ ** varint-encoded deltas between the (usually close)
+ ** indices of the neighbors
+ ** Nodes are addressed by their index in the compressed
+ ** graph; edge costs are the decoded edge lengths
+ ************************************************************
+ ************************************************************/
+
+class CompressedGraph
+{
+private:
+    float tileSize;
+    std::vector<int32_t> tileX;         // Tile coordinates, in tile order
+    std::vector<int32_t> tileY;
+    std::vector<uint32_t> tileFirst;    // First node of each tile, plus a sentinel
+    std::vector<uint16_t> offsets;      // Fixed-point x, y of each node within its tile
+    std::vector<uint32_t> adjacencyStart; // Byte offset of each neighbor list, plus a sentinel
+    std::vector<uint8_t> adjacency;     // Varint-encoded neighbor deltas
+    std::vector<uint32_t> nodeIDs;      // nodeID in the source graph of each node
+    std::vector<uint32_t> indices;      // Index of each source nodeID, UINT32_MAX if absent
+
+    int getTileOfIndex(int index) const;
+
+public:
+    CompressedGraph();
+    int build(const Graph *graph, float tileSize);
+    point_t getLocation(int index) const;
+    int getNeighbors(int index, std::vector<int> *neighbors) const;
+    int getIndex(const Node *node) const;
+    unsigned int getNodeID(int index) const;
+    int getNodeCount() const {
+        return (int)this->nodeIDs.size();
+    }
+    int getTileCount() const {
+        return (int)this->tileX.size();
+    }
+    size_t getMemoryUsage() const;
+};
+
+/************************************************************
+ ************************************************************
+ ** PartitionOverlay Class Definition
+ ** A multilevel partition of a graph for fast exact
+ ** shortest path distances (customizable route planning)
+ ** build splits the nodes into nested cells by recursive
+ ** coordinate bisection; it depends only on the adjacency
+ ** customize computes, for every cell, the cost between each
+ ** pair of its boundary nodes under the edge costs of a
+ ** snapshot; cells of a level are customized in parallel
+ ** and only customize has to be re-run when costs change
+ ** query searches the original edges of the start and goal
+ ** cells and the boundary cliques of every other cell
+ ** Customizations are published like graph snapshots, so
+ ** queries may run while a new one is being computed
+ ** Structural edits to the graph (addNode, addEdge,
+ ** removeEdge, removeNode, compact) need a new build:
+ ** customize and query refuse to run on a stale partition,
+ ** since added edges would never become boundary edges.
+ ** Edits made through Node directly are not detected
+ ************************************************************
+ ************************************************************/
+
+class PartitionOverlay
+{
+private:
+    typedef struct
+    {
+        std::vector<uint32_t> boundary; // nodeIDs of the boundary nodes of a cell
+    } cell_t;
+
+    struct OverlayMetric
+    {
+        std::shared_ptr<const GraphSnapshot> snapshot;      // Edge costs the cliques were built from
+        std::vector<std::vector<std::vector<float> > > cliques; // [level][cell], boundary by boundary
+    };
+
+    const Graph *graph;
+    int levelCount;
+    int nodeCount;                                    // Node count of the graph at build
+    unsigned long structureVersion;                   // Structure version of the graph at build
+    std::vector<std::vector<uint32_t> > cellOfNode;   // [level][nodeID], level 0 is the finest
+    std::vector<std::vector<int32_t> > boundaryIndex; // [level][nodeID], -1 if not on a boundary
+    std::vector<std::vector<cell_t> > cells;          // [level][cell]
+    std::shared_ptr<const OverlayMetric> metric;      // Accessed with std::atomic_load/store only
+
+    int customizeCell(OverlayMetric *next, int level, int cell) const;
+    int getQueryLevel(uint32_t nodeID, uint32_t startID, uint32_t goalID) const;
+    int isStale() const;
+
+public:
+    PartitionOverlay();
+    int build(const Graph *graph, int levelCount, int cellSize);
+    int customize(std::shared_ptr<const GraphSnapshot> snapshot, int threadCount);
+    int query(Node *startNode, Node *goalNode, float *distance) const;
+    int getLevelCount() const {
+        return this->levelCount;
+    }
+    int getCellCount(int level) const;
+    int getBoundaryCount(int level) const;
+    unsigned long getMetricVersion() const;
+};
+
+#ifdef ATLAS_TRACE
+/************************************************************
+ ************************************************************
+ ** Tracer Class Definition
+ ** Collects the scopes recorded by every thread
+ ** Each thread keeps its own stack of open scopes, buffer of
+ ** completed scopes (up to the event limit, for the Chrome
+ ** trace) and fixed table of totals per call stack (for
+ ** folded stacks, which are never dropped); recording takes
+ ** no locks
+ ** On Linux, enableCounters adds the CPU cycles, cache
+ ** misses and branch misses of each scope, read through
+ ** perf_event_open (with rdpmc where the kernel allows it);
+ ** elsewhere they are always 0
+ ** Only sampled iterations appear in the Chrome trace; the
+ ** folded totals of their scopes are scaled by the period
+ ** they were sampled at, so they estimate the full cost
+ ** Scopes nested deeper than TRACE_MAX_DEPTH are not
+ ** recorded; call stacks beyond TRACE_MAX_PATHS are left
+ ** out of the folded totals
+ ** Reset and write the output once the traced threads are
+ ** idle
+ ************************************************************
+ ************************************************************/
+
+class Tracer
+{
+public:
+    static int internName(const char *name);
+    static int enableCounters(int mode);
+    static int setEventLimit(size_t limit);
+    static int setSamplePeriod(int period);
+    static int sample();
+    static int reset();
+    static int writeChromeTrace(const char *path);
+    static int writeFoldedStacks(const char *path, int weight);
+    static size_t getEventCount();
+    static size_t getDroppedCount();
+};
+
+/************************************************************
+ ************************************************************
+ ** TraceScope Class Definition
+ ** Records the time (and counters) between its construction
+ ** and destruction; use through ATLAS_TRACE_SCOPE or
+ ** ATLAS_TRACE_SAMPLED_SCOPE
+ ** Arguments are a name returned by Tracer::internName and,
+ ** for sampled scopes, the weight returned by
+ ** Tracer::sample (0 skips the scope)
+ ************************************************************
+ ************************************************************/
+
+class TraceScope
+{
+private:
+    int weight;                     // 0 when the scope is not recorded
+
+    static void open(int nameID, int weight);
+    static void close();
+
+public:
+    TraceScope(int nameID) : weight(1)
+    {
+        open(nameID, 1);
+    }
+
+    TraceScope(int nameID, int weight) : weight(weight)
+    {                               // Inlined so skipped scopes cost one branch
+        if (weight > 0) {
+            open(nameID, weight);
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (this->weight > 0) {
+            close();
+        }
+    }
+};
+#endif
 }
 
 #endif /* end of include guard: AtlasGraphTools_h */
@@ -1,15 +1,25 @@
 #include <iostream>
+#include <thread>
+#include <queue>
+#include <unordered_map>
+#include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
+#include <unistd.h>
 #include "Atlas/AtlasGraphTools.hpp"
 
 
 using namespace std;
+using namespace Atlas;
 
 
 int main(int argc, char const* argv[]) {
-    srand (time(NULL));
+    // The randomized tests can be replayed by passing the printed seed
+    unsigned int seed = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 10) : (unsigned int)time(NULL);
+    std::cout << "Random seed: " << seed << std::endl;
+    srand (seed);
     int i, j; float rc;
 
     /***********************************************
@@ -274,5 +284,1347 @@ int main(int argc, char const* argv[]) {
     rc = AStar(startNode, goalNode);
     assert(rc == SUCCESS);
     std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test graph snapshots
+    and the snapshot A* search
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for Graph Snapshots:" << std::endl;
+
+    Node *snapA = new Node(0,0);
+    Node *snapB = new Node(1,0);
+    Node *snapC = new Node(2,0);
+    Node *snapD = new Node(1,1);
+    snapA->addNeighbor(snapB);
+    snapB->addNeighbor(snapC);
+    snapA->addNeighbor(snapD);
+    snapD->addNeighbor(snapC);
+
+    Graph *graph = new Graph();
+    std::vector<Node*> path;
+
+    std::cout << "Beginning snapshot A* nullarg test: ";
+    rc = AStar(0x0, snapC, 0x0, &path);
+    assert(rc == NULL_ARG);
+    rc = AStar(snapA, 0x0, 0x0, &path);
+    assert(rc == NULL_ARG);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning edge update batch test: ";
+    EdgeUpdateBatch batch;
+    rc = batch.setEdgeCost(snapA, snapC, 1); // Not neighbors
+    assert(rc == -1);
+    rc = batch.setEdgeCost(snapA, snapB, -1); // Negative cost
+    assert(rc == -2);
+    rc = batch.setEdgeCost(snapA, snapB, NAN); // NaN cost
+    assert(rc == -2);
+    rc = batch.closeEdge(snapA, 0x0);
+    assert(rc == NULL_ARG);
+    rc = graph->publish(0x0);
+    assert(rc == NULL_ARG);
+    assert(batch.getUpdateCount() == 0);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning snapshot isolation test: ";
+    std::shared_ptr<const GraphSnapshot> version0 = graph->acquireSnapshot();
+    assert(version0->getVersion() == 0);
+    rc = AStar(snapA, snapC, version0.get(), &path);
+    assert(rc == SUCCESS);
+    assert(path.size() == 3 && path[1] == snapB);
+
+    rc = batch.closeEdge(snapB, snapA);
+    assert(rc == SUCCESS);
+    rc = graph->publish(&batch);
+    assert(rc == SUCCESS);
+    assert(graph->getVersion() == 1);
+    std::shared_ptr<const GraphSnapshot> version1 = graph->acquireSnapshot();
+    assert(version1->getEdgeCost(snapA, snapB) == INFINITY);
+    rc = AStar(snapA, snapC, version1.get(), &path);
+    assert(rc == SUCCESS);
+    assert(path.size() == 3 && path[1] == snapD);
+    rc = AStar(snapA, snapC, version0.get(), &path); // Old snapshot is unchanged
+    assert(rc == SUCCESS);
+    assert(path.size() == 3 && path[1] == snapB);
+
+    batch.clear();
+    batch.closeEdge(snapA, snapD);
+    graph->publish(&batch);
+    rc = AStar(snapA, snapC, graph->acquireSnapshot().get(), &path);
+    assert(rc == -1);
+
+    batch.clear();
+    batch.resetEdgeCost(snapA, snapB);
+    batch.resetEdgeCost(snapA, snapD);
+    graph->publish(&batch);
+    assert(graph->acquireSnapshot()->getOverrideCount() == 0);
+    assert(graph->acquireSnapshot()->getEdgeCost(snapA, snapB) == getNodeDistance(snapA, snapB));
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning concurrent snapshot reader test: ";
+    std::thread writer([graph, snapB, snapC]() {
+        EdgeUpdateBatch toggle;
+        int k;
+        for (k = 0; k < 200; k++) {
+            toggle.clear();
+            toggle.setEdgeCost(snapB, snapC, (k % 2) ? 1 : 10);
+            graph->publish(&toggle);
+        }
+    });
+    for (i = 0; i < 2000; i++) {
+        std::shared_ptr<const GraphSnapshot> current = graph->acquireSnapshot();
+        std::vector<Node*> readerPath;
+        rc = AStar(snapA, snapC, current.get(), &readerPath);
+        assert(rc == SUCCESS);
+        if (current->getEdgeCost(snapB, snapC) == 10) {
+            assert(readerPath[1] == snapD);
+        }
+        else {
+            assert(readerPath[1] == snapB);
+        }
+    }
+    writer.join();
+    assert(graph->getVersion() == 203);
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test edge removal,
+    node deletion and graph compaction
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for Edge and Node Removal:" << std::endl;
+
+    std::cout << "Beginning removeNeighbor test: ";
+    Node *removeA = new Node(0,0);
+    Node *removeB = new Node(1,0);
+    rc = removeA->removeNeighbor(0x0);
+    assert(rc == NULL_ARG);
+    rc = removeA->removeNeighbor(removeB); // Not neighbors yet
+    assert(rc == -1);
+    removeA->addNeighbor(removeB);
+    rc = removeB->removeNeighbor(removeA);
+    assert(rc == SUCCESS);
+    assert(removeA->isNeighbor(removeB) == 0);
+    assert(removeB->isNeighbor(removeA) == 0);
+    assert(removeA->getNeighborCount() == 0);
+    assert(removeB->getNeighborCount() == 0);
+    rc = removeA->addNeighbor(removeB); // Edges can be added back
+    assert(rc == SUCCESS);
+    assert(removeA->isNeighbor(removeB) == 1);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning neighbor list compaction test: ";
+    const int hubSize = 64;
+    Node *hub = new Node(0,0);
+    Node *spokes[hubSize];
+    for (i = 0; i < hubSize; i++) {
+        spokes[i] = new Node(i, 1);
+        hub->addNeighbor(spokes[i]);
+    }
+    for (i = 0; i < hubSize; i += 2) {
+        rc = hub->removeNeighbor(spokes[i]);
+        assert(rc == SUCCESS);
+        assert(hub->getNeighbors()->getTombstoneCount() * 2 <= hub->getNeighbors()->getNodeCount());
+    }
+    assert(hub->getNeighborCount() == hubSize / 2);
+    assert(hub->getNeighbors()->getLiveCount() == hubSize / 2);
+    for (i = 1; i < hubSize; i += 2) {
+        assert(hub->isNeighbor(spokes[i]) == 1);
+    }
+    hub->getNeighbors()->compact();
+    assert(hub->getNeighbors()->getNodeCount() == hubSize / 2);
+    for (i = 0; i < hub->getNeighbors()->getNodeCount() - 1; i++) {
+        assert(hub->getNeighbors()->getHeuristicAtIndex(i) >= hub->getNeighbors()->getHeuristicAtIndex(i+1));
+    }
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning graph node deletion test: ";
+    Graph *roadGraph = new Graph();
+    Node *roadA = new Node(0,0);
+    Node *roadB = new Node(1,0);
+    Node *roadC = new Node(2,0);
+    Node *roadD = new Node(1,1);
+    roadGraph->addNode(roadA);
+    roadGraph->addNode(roadB);
+    roadGraph->addNode(roadC);
+    roadGraph->addNode(roadD);
+    rc = roadGraph->addNode(roadB);
+    assert(rc == -2);
+    rc = roadGraph->addNode(0x0);
+    assert(rc == NULL_ARG);
+    roadA->addNeighbor(roadB);
+    roadB->addNeighbor(roadC);
+    roadA->addNeighbor(roadD);
+    roadD->addNeighbor(roadC);
+    batch.clear();
+    batch.setEdgeCost(roadB, roadC, 5);
+    batch.setEdgeCost(roadA, roadD, 2);
+    roadGraph->publish(&batch);
+
+    rc = roadGraph->removeNode(removeA); // Not in this graph
+    assert(rc == -1);
+    rc = roadGraph->removeNode(roadB);
+    assert(rc == SUCCESS);
+    rc = roadGraph->removeNode(roadB);
+    assert(rc == -2);
+    assert(roadB->isDeleted());
+    assert(roadA->isNeighbor(roadB) == 0);
+    assert(roadA->getNeighborCount() == 1);
+    assert(roadC->getNeighborCount() == 1);
+    assert(roadGraph->getLiveCount() == 3);
+    rc = AStar(roadA, roadC, roadGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    assert(path.size() == 3 && path[1] == roadD);
+    assert(roadB->getNeighbors()->getNodeCount() == 0);
+    rc = AStar(roadB, roadC, roadGraph->acquireSnapshot().get(), &path); // Removed nodes lead nowhere
+    assert(rc == -1);
+    rc = AStar(roadB, roadC);
+    assert(rc == -1);
+    Graph *lineGraph = new Graph();
+    Node *line[3];
+    for (i = 0; i < 3; i++) {
+        line[i] = new Node(i, 0);
+        lineGraph->addNode(line[i]);
+    }
+    line[0]->addNeighbor(line[1]);
+    line[1]->addNeighbor(line[2]);
+    rc = AStar(line[0], line[2]); // Leaves previous links behind
+    assert(rc == SUCCESS);
+    rc = lineGraph->removeNode(line[1]);
+    assert(rc == SUCCESS);
+    rc = AStar(line[0], line[2], lineGraph->acquireSnapshot().get(), &path); // Not routed through the removed node
+    assert(rc == -1);
+    rc = AStar(line[2], line[0], lineGraph->acquireSnapshot().get(), &path);
+    assert(rc == -1);
+    rc = AStar(line[0], line[2]);
+    assert(rc == -1);
+    delete lineGraph;
+    Graph *hubGraph = new Graph();
+    Node *hubCenter = new Node(0,0);
+    hubGraph->addNode(hubCenter);
+    for (i = 0; i < hubSize; i++) {
+        Node *spoke = new Node(i, 1);
+        hubGraph->addNode(spoke);
+        hubCenter->addNeighbor(spoke);
+    }
+    for (i = 1; i <= hubSize; i += 2) {
+        rc = hubGraph->removeNode(hubGraph->getNodeAtIndex(i));
+        assert(rc == SUCCESS);
+        assert(hubCenter->getNeighbors()->getTombstoneCount() * 2 <= hubCenter->getNeighbors()->getNodeCount());
+    }
+    assert(hubCenter->getNeighborCount() == hubSize / 2);
+    assert(hubCenter->getNeighbors()->getLiveCount() == hubSize / 2);
+    delete hubGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning graph compaction test: ";
+    unsigned long versionBeforeCompact = roadGraph->getVersion();
+    rc = roadGraph->compact();
+    assert(rc == 1);
+    assert(roadGraph->getNodeCount() == 3);
+    assert(roadGraph->getDeletedCount() == 0);
+    for (i = 0; i < roadGraph->getNodeCount(); i++) {
+        Node *live = roadGraph->getNodeAtIndex(i);
+        assert(live->getNodeID() == (unsigned int)i);
+        assert(live->getNeighbors()->getTombstoneCount() == 0);
+        assert(live->getNeighbors()->getNodeCount() == live->getNeighborCount());
+    }
+    assert(roadGraph->getNodeAtIndex(3) == (Node*)OUT_OF_BOUNDS);
+    assert(roadGraph->getVersion() == versionBeforeCompact + 1);
+    assert(roadGraph->acquireSnapshot()->getOverrideCount() == 1);
+    rc = AStar(roadA, roadC, roadGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    delete roadGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning edge re-add cost test: ";
+    Graph *readdGraph = new Graph();
+    Node *readd[3];
+    for (i = 0; i < 3; i++) {
+        readd[i] = new Node(i, 0);
+        readdGraph->addNode(readd[i]);
+    }
+    readdGraph->addEdge(readd[0], readd[1]);
+    readdGraph->addEdge(readd[1], readd[2]);
+    batch.clear();
+    batch.closeEdge(readd[0], readd[1]);
+    readdGraph->publish(&batch);
+    rc = readdGraph->removeEdge(readd[0], readd[1]); // Drops the override with the edge
+    assert(rc == SUCCESS);
+    assert(readdGraph->acquireSnapshot()->getOverrideCount() == 0);
+    readdGraph->addEdge(readd[0], readd[1]);
+    assert(readdGraph->acquireSnapshot()->getEdgeCost(readd[0], readd[1]) == getNodeDistance(readd[0], readd[1]));
+    rc = AStar(readd[0], readd[2], readdGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    batch.clear();
+    batch.closeEdge(readd[1], readd[2]); // Queued before the edge is removed
+    readdGraph->removeEdge(readd[1], readd[2]);
+    readdGraph->publish(&batch);
+    assert(readdGraph->acquireSnapshot()->getOverrideCount() == 0);
+    readdGraph->addEdge(readd[1], readd[2]);
+    assert(readdGraph->acquireSnapshot()->getEdgeCost(readd[1], readd[2]) == getNodeDistance(readd[1], readd[2]));
+    batch.clear();
+    batch.setEdgeCost(readd[0], readd[1], 3);
+    readdGraph->publish(&batch);
+    readd[0]->removeNeighbor(readd[1]); // Not tracked by the graph until compact
+    unsigned long versionBeforeReaddCompact = readdGraph->getVersion();
+    rc = readdGraph->compact();
+    assert(rc == 0);
+    assert(readdGraph->getVersion() == versionBeforeReaddCompact + 1);
+    assert(readdGraph->acquireSnapshot()->getOverrideCount() == 0);
+    readdGraph->addEdge(readd[0], readd[1]);
+    rc = AStar(readd[0], readd[2], readdGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    assert(readdGraph->acquireSnapshot()->getEdgeCost(readd[0], readd[1]) == getNodeDistance(readd[0], readd[1]));
+    delete readdGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test the PathCache
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for PathCache:" << std::endl;
+
+    std::cout << "Beginning PathCache nullarg test: ";
+    PathCache *cache = new PathCache(2);
+    rc = cache->lookup(0x0, snapC, 0, &path);
+    assert(rc == NULL_ARG);
+    rc = cache->store(snapA, 0x0, 0, SUCCESS, &path);
+    assert(rc == NULL_ARG);
+    rc = AStar(snapA, 0x0, 0x0, &path, cache);
+    assert(rc == NULL_ARG);
+    rc = cache->store(snapA, snapC, 0, NULL_ARG, &path); // Errors are not cached
+    assert(rc == -2);
+    assert(cache->getHitRate() == 0);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PathCache hit test: ";
+    std::shared_ptr<const GraphSnapshot> cachedSnapshot = graph->acquireSnapshot();
+    std::vector<Node*> uncachedPath;
+    rc = AStar(snapA, snapC, cachedSnapshot.get(), &uncachedPath);
+    assert(rc == SUCCESS);
+    rc = AStar(snapA, snapC, cachedSnapshot.get(), &path, cache);
+    assert(rc == SUCCESS);
+    assert(path == uncachedPath);
+    assert(cache->getMissCount() == 1 && cache->getHitCount() == 0);
+    path.clear();
+    rc = AStar(snapA, snapC, cachedSnapshot.get(), &path, cache);
+    assert(rc == SUCCESS);
+    assert(path == uncachedPath);
+    assert(cache->getHitCount() == 1);
+    assert(cache->getHitRate() == 0.5);
+    rc = AStar(snapA, removeA, cachedSnapshot.get(), &path, cache); // Unreachable results are cached too
+    assert(rc == -1);
+    rc = AStar(snapA, removeA, cachedSnapshot.get(), &path, cache);
+    assert(rc == -1);
+    assert(cache->getHitCount() == 2);
+    assert(cache->getEntryCount() == 2);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PathCache version invalidation test: ";
+    batch.clear();
+    batch.setEdgeCost(snapB, snapC, 10);
+    graph->publish(&batch);
+    std::shared_ptr<const GraphSnapshot> newerSnapshot = graph->acquireSnapshot();
+    rc = cache->lookup(snapA, snapC, cachedSnapshot->getVersion(), &path); // Old readers still hit
+    assert(rc == SUCCESS);
+    rc = AStar(snapA, snapC, newerSnapshot.get(), &path, cache);
+    assert(rc == SUCCESS);
+    assert(path[1] == snapD);
+    assert(cache->getInvalidationCount() == 1);
+    rc = cache->store(snapA, snapC, cachedSnapshot->getVersion(), SUCCESS, &uncachedPath); // Never downgrade
+    assert(rc == -2);
+    rc = cache->lookup(snapA, snapC, cachedSnapshot->getVersion(), &path);
+    assert(rc == -3);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PathCache eviction test: ";
+    rc = AStar(snapB, snapD, newerSnapshot.get(), &path, cache); // Evicts the least recently used entry
+    assert(rc == SUCCESS);
+    assert(cache->getEntryCount() == 2);
+    assert(cache->getEvictionCount() == 1);
+    rc = cache->lookup(snapA, removeA, cachedSnapshot->getVersion(), &path);
+    assert(rc == -3);
+    rc = cache->lookup(snapA, snapC, newerSnapshot->getVersion(), &path);
+    assert(rc == SUCCESS);
+    cache->clear();
+    assert(cache->getEntryCount() == 0);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PathCache adjacency invalidation test: ";
+    Graph *closedGraph = new Graph();
+    Node *closedA = new Node(0,0);
+    Node *closedB = new Node(1,0);
+    Node *closedC = new Node(2,0);
+    Node *closedD = new Node(1,2);
+    closedGraph->addNode(closedA);
+    closedGraph->addNode(closedB);
+    closedGraph->addNode(closedC);
+    closedGraph->addNode(closedD);
+    rc = closedGraph->addEdge(closedA, removeB); // Not in this graph
+    assert(rc == -1);
+    rc = closedGraph->addEdge(closedA, closedB);
+    assert(rc == SUCCESS);
+    closedGraph->addEdge(closedB, closedC);
+    closedGraph->addEdge(closedA, closedD);
+    closedGraph->addEdge(closedD, closedC);
+    rc = closedGraph->addEdge(closedA, closedB);
+    assert(rc == -2);
+    rc = closedGraph->addEdge(closedA, closedA); // Self loops are rejected
+    assert(rc == -3);
+    rc = closedGraph->removeEdge(closedA, closedA);
+    assert(rc == -3);
+    assert(closedA->getNeighborCount() == closedA->getNeighbors()->getLiveCount());
+    rc = AStar(closedA, closedC, closedGraph->acquireSnapshot().get(), &path, cache);
+    assert(rc == SUCCESS);
+    assert(path[1] == closedB);
+    unsigned long versionBeforeClose = closedGraph->getVersion();
+    rc = closedGraph->removeEdge(closedB, closedC);
+    assert(rc == SUCCESS);
+    assert(closedGraph->getVersion() == versionBeforeClose + 1);
+    rc = AStar(closedA, closedC, closedGraph->acquireSnapshot().get(), &path, cache);
+    assert(rc == SUCCESS);
+    assert(path[1] == closedD);
+    rc = closedGraph->removeEdge(closedB, closedC);
+    assert(rc == -1);
+    rc = closedGraph->removeNode(closedD);
+    assert(rc == SUCCESS);
+    rc = AStar(closedA, closedC, closedGraph->acquireSnapshot().get(), &path, cache);
+    assert(rc == -1);
+    rc = closedGraph->addEdge(closedB, closedC);
+    assert(rc == SUCCESS);
+    rc = AStar(closedA, closedC, closedGraph->acquireSnapshot().get(), &path, cache);
+    assert(rc == SUCCESS);
+    assert(path.size() == 3 && path[1] == closedB);
+    rc = AStar(closedA, closedC, 0x0, &path, cache); // Searches without a snapshot are not cached
+    assert(rc == SUCCESS);
+    rc = closedGraph->removeNode(closedB);
+    assert(rc == SUCCESS);
+    rc = AStar(closedA, closedC, 0x0, &path, cache);
+    assert(rc == -1);
+    cache->clear();
+    delete closedGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning shared PathCache test: ";
+    PathCache *sharedCache = new PathCache(16);
+    std::vector<std::thread> readers;
+    for (i = 0; i < 4; i++) {
+        readers.push_back(std::thread([graph, sharedCache, snapA, snapB, snapC, snapD]() {
+            Node *ends[4] = {snapA, snapB, snapC, snapD};
+            std::vector<Node*> readerPath;
+            int k;
+            for (k = 0; k < 500; k++) {
+                std::shared_ptr<const GraphSnapshot> current = graph->acquireSnapshot();
+                int readerRc = AStar(ends[k % 4], ends[(k / 4) % 4], current.get(), &readerPath, sharedCache);
+                assert(readerRc == SUCCESS);
+                assert(readerPath.front() == ends[k % 4] && readerPath.back() == ends[(k / 4) % 4]);
+            }
+        }));
+    }
+    for (i = 0; i < 4; i++) {
+        readers[i].join();
+    }
+    assert(sharedCache->getHitCount() + sharedCache->getMissCount() == 2000);
+    assert(sharedCache->getHitRate() > 0.9);
+    delete sharedCache;
+    delete cache;
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test the connectivity
+    index
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for the Connectivity Index:" << std::endl;
+
+    std::cout << "Beginning mayReach test: ";
+    Graph *islands = new Graph();
+    const int islandSize = 8;
+    Node *westIsland[islandSize];
+    Node *eastIsland[islandSize];
+    for (i = 0; i < islandSize; i++) {
+        westIsland[i] = new Node(i, 0);
+        eastIsland[i] = new Node(i + 100, 0);
+        islands->addNode(westIsland[i]);
+        islands->addNode(eastIsland[i]);
+        if (i > 0) {
+            westIsland[i-1]->addNeighbor(westIsland[i]);
+            eastIsland[i-1]->addNeighbor(eastIsland[i]);
+        }
+    }
+    rc = westIsland[0]->mayReach(0x0);
+    assert(rc == NULL_ARG);
+    assert(westIsland[0]->mayReach(westIsland[islandSize-1]) == 1);
+    assert(westIsland[0]->mayReach(eastIsland[0]) == 0);
+    assert(westIsland[0]->getComponent() == westIsland[islandSize-1]->getComponent());
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning unreachable goal rejection test: ";
+    rc = AStar(westIsland[0], eastIsland[islandSize-1]);
+    assert(rc == -1);
+    rc = AStar(westIsland[0], eastIsland[islandSize-1], islands->acquireSnapshot().get(), &path);
+    assert(rc == -1);
+    assert(path.empty());
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning connectivity index update test: ";
+    westIsland[islandSize-1]->addNeighbor(eastIsland[0]); // Build a bridge
+    assert(westIsland[0]->mayReach(eastIsland[islandSize-1]) == 1);
+    rc = AStar(westIsland[0], eastIsland[islandSize-1], islands->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    assert((int)path.size() == 2 * islandSize);
+    westIsland[islandSize-1]->removeNeighbor(eastIsland[0]); // Component is now stale
+    assert(westIsland[0]->mayReach(eastIsland[islandSize-1]) == 1);
+    rc = AStar(westIsland[0], eastIsland[islandSize-1], islands->acquireSnapshot().get(), &path);
+    assert(rc == -1);
+    rc = islands->rebuildComponents();
+    assert(rc == SUCCESS);
+    assert(westIsland[0]->mayReach(eastIsland[islandSize-1]) == 0);
+    assert(westIsland[0]->mayReach(westIsland[islandSize-1]) == 1);
+    islands->addEdge(westIsland[islandSize-1], eastIsland[0]);
+    islands->removeEdge(westIsland[islandSize-1], eastIsland[0]);
+    assert(westIsland[0]->mayReach(eastIsland[islandSize-1]) == 1);
+    rc = islands->compact(); // Nothing to free, but rebuilds the stale index
+    assert(rc == 0);
+    assert(westIsland[0]->mayReach(eastIsland[islandSize-1]) == 0);
+    islands->removeNode(westIsland[3]);
+    islands->compact();
+    assert(westIsland[0]->mayReach(westIsland[islandSize-1]) == 0);
+    assert(westIsland[4]->mayReach(westIsland[islandSize-1]) == 1);
+    delete islands;
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test cancellable
+    searches and the QueryExecutor
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for the QueryExecutor:" << std::endl;
+
+    const int chainSize = 2000;
+    Graph *chainGraph = new Graph();
+    Node *chain[chainSize];
+    for (i = 0; i < chainSize; i++) {
+        chain[i] = new Node(i, (i % 2) * 0.5);
+        chainGraph->addNode(chain[i]);
+        if (i > 0) {
+            chain[i-1]->addNeighbor(chain[i]);
+        }
+    }
+    std::shared_ptr<const GraphSnapshot> chainSnapshot = chainGraph->acquireSnapshot();
+
+    std::cout << "Beginning SearchControl budget test: ";
+    SearchControl unlimited(0, 0);
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, 0x0, &unlimited);
+    assert(rc == SUCCESS);
+    assert((int)path.size() == chainSize);
+    assert(unlimited.getExpansions() >= chainSize);
+    SearchControl expansionBudget(100, 0);
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, 0x0, &expansionBudget);
+    assert(rc == BUDGET_EXCEEDED);
+    assert(path.empty());
+    assert(expansionBudget.getExpansions() == 101);
+    SearchControl timeBudget(0, 1);
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, 0x0, &timeBudget);
+    assert(rc == BUDGET_EXCEEDED);
+    SearchControl cancelled(0, 0);
+    cancelled.cancel();
+    assert(cancelled.isCancelled());
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, 0x0, &cancelled);
+    assert(rc == SEARCH_CANCELLED);
+    PathCache *budgetCache = new PathCache(4);
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, budgetCache, &expansionBudget);
+    assert(rc == BUDGET_EXCEEDED);
+    assert(budgetCache->getEntryCount() == 0); // Incomplete searches are not cached
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, budgetCache, &unlimited);
+    assert(rc == SUCCESS);
+    assert(unlimited.getExpansions() >= chainSize);
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, budgetCache, &unlimited); // Hit
+    assert(rc == SUCCESS);
+    assert(unlimited.getExpansions() == 0);
+    path.clear();
+    rc = AStar(chain[0], chain[chainSize-1], chainSnapshot.get(), &path, budgetCache, &cancelled);
+    assert(rc == SEARCH_CANCELLED);
+    assert(path.empty());
+    delete budgetCache;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning QueryExecutor future test: ";
+    QueryExecutor *executor = new QueryExecutor(chainGraph, 3, 0x0);
+    std::vector<std::future<query_result_t> > futures;
+    for (i = 0; i < 12; i++) {
+        futures.push_back(executor->submit(chain[i], chain[chainSize-1-i], std::shared_ptr<SearchControl>()));
+    }
+    for (i = 0; i < 12; i++) {
+        query_result_t result = futures[i].get();
+        assert(result.result == SUCCESS);
+        assert((int)result.path.size() == chainSize - 2 * i);
+        assert(result.version == chainSnapshot->getVersion());
+        assert(result.expansions > 0);
+    }
+    query_result_t nullResult = executor->submit(0x0, chain[0], std::shared_ptr<SearchControl>()).get();
+    assert(nullResult.result == NULL_ARG);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning QueryExecutor callback and cancel test: ";
+    std::atomic<int> callbackCount(0);
+    std::atomic<int> cancelledCount(0);
+    std::vector<std::shared_ptr<SearchControl> > controls;
+    std::promise<void> gate;
+    std::shared_future<void> gateOpen = gate.get_future().share();
+    for (i = 0; i < 3; i++) { // Hold every worker until the cancels are issued
+        rc = executor->submit(chain[0], chain[1], std::shared_ptr<SearchControl>(), [&callbackCount, gateOpen](const query_result_t &) {
+            gateOpen.wait();
+            callbackCount++;
+        });
+        assert(rc == SUCCESS);
+    }
+    for (i = 0; i < 8; i++) {
+        std::shared_ptr<SearchControl> control(new SearchControl(0, 0));
+        controls.push_back(control);
+        rc = executor->submit(chain[0], chain[chainSize-1], control, [&callbackCount, &cancelledCount](const query_result_t &result) {
+            assert(result.result == SUCCESS || result.result == SEARCH_CANCELLED);
+            if (result.result == SEARCH_CANCELLED) {
+                cancelledCount++;
+            }
+            callbackCount++;
+        });
+        assert(rc == SUCCESS);
+    }
+    for (i = 0; i < 8; i++) {
+        controls[i]->cancel();
+    }
+    gate.set_value();
+    executor->shutdown();
+    assert(callbackCount == 11);
+    assert(cancelledCount == 8);
+    assert(executor->getPendingCount() == 0);
+    rc = executor->submit(chain[0], chain[1], std::shared_ptr<SearchControl>(), [](const query_result_t &) {});
+    assert(rc == SEARCH_CANCELLED);
+    delete executor;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning QueryExecutor shutdown cancel test: ";
+    executor = new QueryExecutor(chainGraph, 1, 0x0);
+    std::shared_ptr<SearchControl> runningControl(new SearchControl(0, 0));
+    std::promise<void> runningGate;
+    std::shared_future<void> runningGateOpen = runningGate.get_future().share();
+    std::atomic<int> queuedResult(SUCCESS);
+    rc = executor->submit(chain[0], chain[1], runningControl, [runningGateOpen](const query_result_t &) {
+        runningGateOpen.wait(); // Keeps the query running until shutdown has cancelled it
+    });
+    assert(rc == SUCCESS);
+    rc = executor->submit(chain[0], chain[chainSize-1], std::shared_ptr<SearchControl>(), [&queuedResult](const query_result_t &result) {
+        queuedResult = result.result;
+    });
+    assert(rc == SUCCESS);
+    while (executor->getPendingCount() > 1) {
+        std::this_thread::yield();
+    }
+    std::thread shutter([executor]() {
+        executor->shutdown();
+    });
+    while (!runningControl->isCancelled()) {
+        std::this_thread::yield();
+    }
+    runningGate.set_value();
+    shutter.join();
+    assert(queuedResult == SEARCH_CANCELLED);
+    delete executor;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning QueryExecutor structural edit test: ";
+    executor = new QueryExecutor(chainGraph, 3, 0x0);
+    futures.clear();
+    for (i = 0; i < 60; i++) {
+        futures.push_back(executor->submit(chain[0], chain[chainSize-1], std::shared_ptr<SearchControl>()));
+    }
+    for (i = 0; i < 40; i++) { // Edits wait for running searches; queued ones wait for the edits
+        rc = chainGraph->removeEdge(chain[chainSize/2], chain[chainSize/2+1]);
+        assert(rc == SUCCESS);
+        rc = chainGraph->addEdge(chain[chainSize/2], chain[chainSize/2+1]);
+        assert(rc == SUCCESS);
+    }
+    rc = chainGraph->removeNode(chain[chainSize/4]); // Not an end of any query, so compact may free it
+    assert(rc == SUCCESS);
+    rc = chainGraph->compact();
+    assert(rc == 1);
+    for (i = 0; i < 60; i++) {
+        query_result_t result = futures[i].get();
+        assert(result.result == SUCCESS || result.result == -1);
+        if (result.result == SUCCESS) {
+            assert((int)result.path.size() == chainSize);
+        }
+    }
+    query_result_t afterEdit = executor->submit(chain[0], chain[chainSize-1], std::shared_ptr<SearchControl>()).get();
+    assert(afterEdit.result == -1);
+    afterEdit = executor->submit(chain[chainSize/2], chain[chainSize-1], std::shared_ptr<SearchControl>()).get();
+    assert(afterEdit.result == SUCCESS);
+    assert((int)afterEdit.path.size() == chainSize / 2);
+    delete executor;
+    delete chainGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test the CompressedGraph
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for the CompressedGraph:" << std::endl;
+
+    const int gridSize = 60;
+    Graph *gridGraph = new Graph();
+    Node *grid[gridSize][gridSize];
+    for (i = 0; i < gridSize; i++) {
+        for (j = 0; j < gridSize; j++) {
+            float jitterX = static_cast <float> (rand()) / (static_cast <float> (RAND_MAX/(0.4))) - 0.2;
+            float jitterY = static_cast <float> (rand()) / (static_cast <float> (RAND_MAX/(0.4))) - 0.2;
+            grid[i][j] = new Node(-30 + i + jitterX, -30 + j + jitterY);
+            gridGraph->addNode(grid[i][j]);
+            if (i > 0) {
+                grid[i][j]->addNeighbor(grid[i-1][j]);
+            }
+            if (j > 0 && rand() % 4 != 0) {
+                grid[i][j]->addNeighbor(grid[i][j-1]);
+            }
+        }
+    }
+    Node *gridIsland = new Node(0.5, 0.5);
+    gridGraph->addNode(gridIsland);
+    gridGraph->removeNode(grid[5][5]);
+
+    std::cout << "Beginning CompressedGraph nullarg test: ";
+    CompressedGraph *compressed = new CompressedGraph();
+    rc = compressed->build(0x0, 8);
+    assert(rc == NULL_ARG);
+    rc = compressed->build(gridGraph, 0);
+    assert(rc == -2);
+    rc = AStar((CompressedGraph*)0x0, 0, 1, 0x0);
+    assert(rc == NULL_ARG);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning CompressedGraph encoding test: ";
+    rc = compressed->build(gridGraph, 8);
+    assert(rc == SUCCESS);
+    assert(compressed->getNodeCount() == gridGraph->getLiveCount());
+    assert(compressed->getTileCount() > 1);
+    assert(compressed->getIndex(grid[5][5]) == -1);
+    rc = AStar(compressed, 0, compressed->getNodeCount(), 0x0);
+    assert(rc == OUT_OF_BOUNDS);
+    std::vector<int> decoded;
+    assert(compressed->getNeighbors(compressed->getNodeCount(), &decoded) == OUT_OF_BOUNDS);
+    assert(compressed->getNeighbors(0, 0x0) == NULL_ARG);
+    size_t uncompressedBytes = sizeof(Graph);
+    for (i = 0; i < gridGraph->getNodeCount(); i++) {
+        Node *original = gridGraph->getNodeAtIndex(i);
+        if (original->isDeleted()) {
+            continue;
+        }
+        uncompressedBytes += sizeof(Node*) + sizeof(Node) + sizeof(PriorityQueue) +
+                             original->getNeighbors()->getNodeCount() * (sizeof(Node*) + sizeof(float));
+        int index = compressed->getIndex(original);
+        assert(index >= 0);
+        assert(compressed->getNodeID(index) == original->getNodeID());
+        point_t location = compressed->getLocation(index);
+        assert(fabs(location.x - original->getLocation().x) <= 8.0 / 65535 + 1e-4);
+        assert(fabs(location.y - original->getLocation().y) <= 8.0 / 65535 + 1e-4);
+        rc = compressed->getNeighbors(index, &decoded);
+        assert(rc == SUCCESS);
+        assert((int)decoded.size() == original->getNeighborCount());
+        for (j = 0; j < (int)decoded.size(); j++) {
+            assert(original->isNeighbor(gridGraph->getNodeAtIndex(compressed->getNodeID(decoded[j]))) == 1);
+        }
+    }
+    assert(uncompressedBytes > 3 * compressed->getMemoryUsage());
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning CompressedGraph A* test: ";
+    std::vector<int> compressedPath;
+    for (i = 0; i < 20; i++) {
+        Node *from = grid[rand() % gridSize][rand() % gridSize];
+        Node *to = grid[rand() % gridSize][rand() % gridSize];
+        if (from->isDeleted() || to->isDeleted()) {
+            continue;
+        }
+        int expected = AStar(from, to, gridGraph->acquireSnapshot().get(), &path);
+        rc = AStar(compressed, compressed->getIndex(from), compressed->getIndex(to), &compressedPath);
+        assert(rc == expected);
+        if (rc != SUCCESS) {
+            continue;
+        }
+        float expectedLength = 0;
+        float compressedLength = 0;
+        for (j = 1; j < (int)path.size(); j++) {
+            expectedLength += getNodeDistance(path[j-1], path[j]);
+        }
+        for (j = 1; j < (int)compressedPath.size(); j++) {
+            Node *previousNode = gridGraph->getNodeAtIndex(compressed->getNodeID(compressedPath[j-1]));
+            Node *nextNode = gridGraph->getNodeAtIndex(compressed->getNodeID(compressedPath[j]));
+            assert(previousNode->isNeighbor(nextNode) == 1);
+            compressedLength += getNodeDistance(previousNode, nextNode);
+        }
+        assert(compressedPath.front() == compressed->getIndex(from));
+        assert(compressedPath.back() == compressed->getIndex(to));
+        assert(fabs(compressedLength - expectedLength) <= 0.02 * expectedLength + 1e-3);
+    }
+    rc = AStar(compressed, compressed->getIndex(grid[0][0]), compressed->getIndex(gridIsland), &compressedPath);
+    assert(rc == -1);
+    assert(compressedPath.empty());
+    delete compressed;
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test the PartitionOverlay
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for the PartitionOverlay:" << std::endl;
+
+    const int overlaySize = 40;
+    Graph *overlayGraph = new Graph();
+    Node *overlayGrid[overlaySize][overlaySize];
+    for (i = 0; i < overlaySize; i++) {
+        for (j = 0; j < overlaySize; j++) {
+            float jitterX = static_cast <float> (rand()) / (static_cast <float> (RAND_MAX/(0.4))) - 0.2;
+            float jitterY = static_cast <float> (rand()) / (static_cast <float> (RAND_MAX/(0.4))) - 0.2;
+            overlayGrid[i][j] = new Node(i + jitterX, j + jitterY);
+            overlayGraph->addNode(overlayGrid[i][j]);
+            if (i > 0 && rand() % 5 != 0) {
+                overlayGrid[i][j]->addNeighbor(overlayGrid[i-1][j]);
+            }
+            if (j > 0 && rand() % 5 != 0) {
+                overlayGrid[i][j]->addNeighbor(overlayGrid[i][j-1]);
+            }
+        }
+    }
+
+    //
+    // Plain Dijkstra search used as the reference distance
+    //
+
+    auto referenceDistance = [](Node *from, Node *to, const GraphSnapshot *snapshot) {
+        typedef std::pair<float, Node*> entry_t;
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t> > open;
+        std::unordered_map<Node*, float> lengths;
+        lengths[from] = 0;
+        open.push(entry_t(0, from));
+        while (!open.empty()) {
+            entry_t top = open.top();
+            open.pop();
+            if (top.second == to) {
+                return top.first;
+            }
+            if (top.first > lengths[top.second]) {
+                continue;
+            }
+            PriorityQueue *neighbors = top.second->getNeighbors();
+            int k;
+            for (k = 0; k < neighbors->getNodeCount(); k++) {
+                Node *next = neighbors->getNodeAtIndex(k);
+                if (next == (Node*)NULL) { // Tombstone left by a removal
+                    continue;
+                }
+                float cost = snapshot->getEdgeCost(top.second, next);
+                if (cost == INFINITY) {
+                    continue;
+                }
+                if (!lengths.count(next) || top.first + cost < lengths[next]) {
+                    lengths[next] = top.first + cost;
+                    open.push(entry_t(top.first + cost, next));
+                }
+            }
+        }
+        return (float)INFINITY;
+    };
+
+    std::cout << "Beginning PartitionOverlay nullarg test: ";
+    PartitionOverlay *overlay = new PartitionOverlay();
+    float overlayDistance;
+    rc = overlay->build(0x0, 3, 16);
+    assert(rc == NULL_ARG);
+    rc = overlay->build(overlayGraph, 0, 16);
+    assert(rc == -2);
+    rc = overlay->build(overlayGraph, 40, 1);
+    assert(rc == -2);
+    assert(overlay->getLevelCount() == 0);
+    rc = overlay->customize(std::shared_ptr<const GraphSnapshot>(), 1);
+    assert(rc == -2);
+    rc = overlay->query(overlayGrid[0][0], overlayGrid[1][1], &overlayDistance);
+    assert(rc == -2);
+    rc = overlay->query(overlayGrid[0][0], 0x0, &overlayDistance);
+    assert(rc == NULL_ARG);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PartitionOverlay build test: ";
+    rc = overlay->build(overlayGraph, 3, 16);
+    assert(rc == SUCCESS);
+    assert(overlay->getLevelCount() == 3);
+    assert(overlay->getCellCount(0) >= overlaySize * overlaySize / 16);
+    assert(overlay->getCellCount(1) < overlay->getCellCount(0));
+    assert(overlay->getCellCount(2) < overlay->getCellCount(1));
+    assert(overlay->getCellCount(2) >= 2);
+    assert(overlay->getBoundaryCount(2) < overlay->getBoundaryCount(0));
+    assert(overlay->getCellCount(3) == OUT_OF_BOUNDS);
+    Graph *tinyGraph = new Graph();
+    Node *tiny[4];
+    for (i = 0; i < 4; i++) {
+        tiny[i] = new Node(i, 0);
+        tinyGraph->addNode(tiny[i]);
+        if (i > 0) {
+            tiny[i-1]->addNeighbor(tiny[i]);
+        }
+    }
+    PartitionOverlay *tinyOverlay = new PartitionOverlay();
+    rc = tinyOverlay->build(tinyGraph, 30, 1); // More levels than 4 nodes can be split into
+    assert(rc == SUCCESS);
+    assert(tinyOverlay->getLevelCount() == 2);
+    assert(tinyOverlay->getCellCount(0) == 4);
+    assert(tinyOverlay->getCellCount(1) == 2);
+    rc = tinyOverlay->customize(std::shared_ptr<const GraphSnapshot>(), 2);
+    assert(rc == SUCCESS);
+    rc = tinyOverlay->query(tiny[0], tiny[3], &overlayDistance);
+    assert(rc == SUCCESS);
+    assert(overlayDistance == 3);
+    delete tinyOverlay;
+    delete tinyGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PartitionOverlay query test: ";
+    std::shared_ptr<const GraphSnapshot> overlaySnapshot = overlayGraph->acquireSnapshot();
+    rc = overlay->customize(overlaySnapshot, 4);
+    assert(rc == SUCCESS);
+    rc = overlay->query(overlayGrid[0][0], removeA, &overlayDistance);
+    assert(rc == -3);
+    for (i = 0; i < 40; i++) {
+        Node *from = overlayGrid[rand() % overlaySize][rand() % overlaySize];
+        Node *to = overlayGrid[rand() % overlaySize][rand() % overlaySize];
+        float expected = referenceDistance(from, to, overlaySnapshot.get());
+        rc = overlay->query(from, to, &overlayDistance);
+        if (expected == INFINITY) {
+            assert(rc == -1);
+            assert(overlayDistance == INFINITY);
+        }
+        else {
+            assert(rc == SUCCESS);
+            assert(fabs(overlayDistance - expected) <= 1e-3 * expected + 1e-4);
+        }
+    }
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PartitionOverlay customization test: ";
+    batch.clear();
+    for (i = 0; i < overlaySize; i++) {
+        for (j = 1; j < overlaySize; j++) {
+            if (overlayGrid[i][j]->isNeighbor(overlayGrid[i][j-1]) && rand() % 3 == 0) {
+                if (rand() % 4 == 0) {
+                    batch.closeEdge(overlayGrid[i][j], overlayGrid[i][j-1]);
+                }
+                else {
+                    batch.setEdgeCost(overlayGrid[i][j], overlayGrid[i][j-1], 1 + rand() % 5);
+                }
+            }
+        }
+    }
+    overlayGraph->publish(&batch);
+    overlaySnapshot = overlayGraph->acquireSnapshot();
+    rc = overlay->customize(overlaySnapshot, 3);
+    assert(rc == SUCCESS);
+    assert(overlay->getMetricVersion() == overlaySnapshot->getVersion());
+    for (i = 0; i < 40; i++) {
+        Node *from = overlayGrid[rand() % overlaySize][rand() % overlaySize];
+        Node *to = overlayGrid[rand() % overlaySize][rand() % overlaySize];
+        float expected = referenceDistance(from, to, overlaySnapshot.get());
+        rc = overlay->query(from, to, &overlayDistance);
+        if (expected == INFINITY) {
+            assert(rc == -1);
+        }
+        else {
+            assert(rc == SUCCESS);
+            assert(fabs(overlayDistance - expected) <= 1e-3 * expected + 1e-4);
+        }
+    }
+    delete overlay;
+    delete overlayGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning PartitionOverlay graph edit test: ";
+    const int editLineSize = 100;
+    Graph *editGraph = new Graph();
+    Node *editLine[editLineSize];
+    for (i = 0; i < editLineSize; i++) {
+        editLine[i] = new Node(i, 0);
+        editGraph->addNode(editLine[i]);
+        if (i > 0) {
+            editLine[i-1]->addNeighbor(editLine[i]);
+        }
+    }
+    PartitionOverlay *editOverlay = new PartitionOverlay();
+    rc = editOverlay->build(editGraph, 3, 8);
+    assert(rc == SUCCESS);
+    rc = editOverlay->customize(editGraph->acquireSnapshot(), 2);
+    assert(rc == SUCCESS);
+    Node *shortcut = new Node(50, 1); // Joins both ends of the line
+    editGraph->addNode(shortcut);
+    editGraph->addEdge(editLine[0], shortcut);
+    editGraph->addEdge(shortcut, editLine[editLineSize-1]);
+    rc = editOverlay->customize(editGraph->acquireSnapshot(), 2); // Partitioned before the edit
+    assert(rc == -4);
+    rc = editOverlay->query(editLine[0], editLine[editLineSize-1], &overlayDistance);
+    assert(rc == -4);
+    rc = editOverlay->build(editGraph, 3, 8);
+    assert(rc == SUCCESS);
+    rc = editOverlay->customize(editGraph->acquireSnapshot(), 2);
+    assert(rc == SUCCESS);
+    rc = editOverlay->query(editLine[1], shortcut, &overlayDistance);
+    assert(rc == SUCCESS);
+    assert(fabs(overlayDistance - referenceDistance(editLine[1], shortcut,
+                                                    editGraph->acquireSnapshot().get())) < 1e-3);
+    editGraph->removeEdge(editLine[0], shortcut); // Edge edits alone also need a new build
+    rc = editOverlay->query(editLine[0], editLine[editLineSize-1], &overlayDistance);
+    assert(rc == -4);
+    delete editOverlay;
+    delete editGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    /***********************************************
+    ************************************************
+    The following unit tests test building a graph
+    from node and edge arrays
+    ************************************************
+    ***********************************************/
+
+    std::cout << "Beginning Tests for Graph::build:" << std::endl;
+
+    const int builtNodeCount = 500;
+    const int builtEdgeCount = 3000;
+    std::vector<float> builtX(builtNodeCount);
+    std::vector<float> builtY(builtNodeCount);
+    std::vector<edge_t> builtEdges(builtEdgeCount);
+    for (i = 0; i < builtNodeCount; i++) {
+        builtX[i] = -100 + static_cast <float> (rand()) /( static_cast <float> (RAND_MAX/(200)));
+        builtY[i] = -100 + static_cast <float> (rand()) /( static_cast <float> (RAND_MAX/(200)));
+    }
+    for (i = 0; i < builtEdgeCount; i++) { // Includes duplicates, reversed duplicates and self loops
+        builtEdges[i].from = rand() % builtNodeCount;
+        builtEdges[i].to = (i % 50 == 0) ? builtEdges[i].from : rand() % builtNodeCount;
+        if (i % 7 == 0 && i > 0) {
+            builtEdges[i].from = builtEdges[i-1].to;
+            builtEdges[i].to = builtEdges[i-1].from;
+        }
+    }
+
+    std::cout << "Beginning Graph::build nullarg test: ";
+    Graph *builtGraph = new Graph();
+    rc = builtGraph->build(0x0, builtY.data(), builtNodeCount, builtEdges.data(), builtEdgeCount, 0, 4);
+    assert(rc == NULL_ARG);
+    edge_t badEdge = {0, builtNodeCount};
+    rc = builtGraph->build(builtX.data(), builtY.data(), builtNodeCount, &badEdge, 1, 0, 4);
+    assert(rc == OUT_OF_BOUNDS);
+    assert(builtGraph->getNodeCount() == 0);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning undirected Graph::build test: ";
+    rc = builtGraph->build(builtX.data(), builtY.data(), builtNodeCount, builtEdges.data(), builtEdgeCount, 0, 4);
+    assert(rc == SUCCESS);
+    rc = builtGraph->build(builtX.data(), builtY.data(), builtNodeCount, builtEdges.data(), builtEdgeCount, 0, 4);
+    assert(rc == -2);
+    assert(builtGraph->getNodeCount() == builtNodeCount);
+
+    Graph *addedGraph = new Graph();
+    for (i = 0; i < builtNodeCount; i++) {
+        addedGraph->addNode(new Node(builtX[i], builtY[i]));
+    }
+    for (i = 0; i < builtEdgeCount; i++) {
+        if (builtEdges[i].from != builtEdges[i].to) {
+            addedGraph->getNodeAtIndex(builtEdges[i].from)->addNeighbor(addedGraph->getNodeAtIndex(builtEdges[i].to));
+        }
+    }
+    for (i = 0; i < builtNodeCount; i++) {
+        Node *built = builtGraph->getNodeAtIndex(i);
+        Node *added = addedGraph->getNodeAtIndex(i);
+        assert(built->getNodeID() == (unsigned int)i);
+        assert(built->getLocation().x == builtX[i] && built->getLocation().y == builtY[i]);
+        assert(built->getNeighborCount() == added->getNeighborCount());
+        assert(built->getNeighbors()->getNodeCount() == added->getNeighbors()->getNodeCount());
+        for (j = 0; j < built->getNeighborCount(); j++) {
+            Node *neighbor = built->getNeighbors()->getNodeAtIndex(j);
+            assert(added->isNeighbor(addedGraph->getNodeAtIndex(neighbor->getNodeID())) == 1);
+            assert(built->getNeighbors()->getHeuristicAtIndex(j) == added->getNeighbors()->getHeuristicAtIndex(j));
+        }
+        for (j = 0; j < builtNodeCount; j += 37) {
+            assert(built->mayReach(builtGraph->getNodeAtIndex(j)) == added->mayReach(addedGraph->getNodeAtIndex(j)));
+        }
+    }
+    delete addedGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning directed Graph::build test: ";
+    float lineX[4] = {0, 1, 2, 3};
+    float lineY[4] = {0, 0, 0, 0};
+    edge_t oneWay[3] = {{0, 1}, {1, 2}, {2, 3}};
+    Graph *directedGraph = new Graph();
+    rc = directedGraph->build(lineX, lineY, 4, oneWay, 3, 1, 2);
+    assert(rc == SUCCESS);
+    Node *first = directedGraph->getNodeAtIndex(0);
+    Node *last = directedGraph->getNodeAtIndex(3);
+    assert(first->isNeighbor(directedGraph->getNodeAtIndex(1)) == 1);
+    assert(directedGraph->getNodeAtIndex(1)->isNeighbor(first) == 0);
+    assert(first->mayReach(last) == 1 && last->mayReach(first) == 1);
+    rc = AStar(first, last, directedGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    assert(path.size() == 4);
+    rc = AStar(last, first, directedGraph->acquireSnapshot().get(), &path);
+    assert(rc == -1);
+    rc = AStar(first, last);
+    assert(rc == SUCCESS);
+    rc = AStar(last, directedGraph->getNodeAtIndex(1)); // No out-edges, despite the links left behind
+    assert(rc == -1);
+    Node *removed = directedGraph->getNodeAtIndex(2);
+    directedGraph->removeNode(removed);
+    assert(directedGraph->getNodeAtIndex(1)->isNeighbor(removed) == 1); // In-edge kept until compact
+    rc = AStar(first, last, directedGraph->acquireSnapshot().get(), &path);
+    assert(rc == -1);
+    rc = AStar(first, last);
+    assert(rc == -1);
+    rc = AStar(first, removed, directedGraph->acquireSnapshot().get(), &path); // Not reachable through its in-edges
+    assert(rc == -1);
+    rc = AStar(first, removed);
+    assert(rc == -1);
+    rc = directedGraph->compact();
+    assert(rc == 1);
+    assert(directedGraph->getNodeAtIndex(1)->getNeighborCount() == 0);
+    assert(directedGraph->getNodeAtIndex(1)->getNeighbors()->getNodeCount() == 0);
+    assert(first->mayReach(last) == 0);
+    delete directedGraph;
+    delete builtGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning directed edge update test: ";
+    edge_t twoWay[3] = {{0, 1}, {1, 0}, {1, 2}};
+    Graph *twoWayGraph = new Graph();
+    rc = twoWayGraph->build(lineX, lineY, 3, twoWay, 3, 1, 1);
+    assert(rc == SUCCESS);
+    assert(twoWayGraph->isDirected());
+    Node *wayA = twoWayGraph->getNodeAtIndex(0);
+    Node *wayB = twoWayGraph->getNodeAtIndex(1);
+    Node *wayC = twoWayGraph->getNodeAtIndex(2);
+    batch.clear();
+    rc = batch.setEdgeCost(wayA, wayB, 5);
+    assert(rc == SUCCESS);
+    rc = batch.setEdgeCost(wayC, wayB, 5); // Only the other way exists
+    assert(rc == -1);
+    rc = batch.closeEdge(wayB, wayC);
+    assert(rc == SUCCESS);
+    twoWayGraph->publish(&batch);
+    assert(twoWayGraph->acquireSnapshot()->getEdgeCost(wayA, wayB) == 5);
+    assert(twoWayGraph->acquireSnapshot()->getEdgeCost(wayB, wayA) == 1);
+    rc = twoWayGraph->removeEdge(wayA, wayB);
+    assert(rc == SUCCESS);
+    assert(wayA->isNeighbor(wayB) == 0);
+    assert(wayB->isNeighbor(wayA) == 1);
+    assert(wayB->getNeighborCount() == 2);
+    rc = twoWayGraph->addEdge(wayC, wayA);
+    assert(rc == SUCCESS);
+    assert(wayC->isNeighbor(wayA) == 1);
+    assert(wayA->isNeighbor(wayC) == 0);
+    assert(wayA->getNeighborCount() == 0);
+    delete twoWayGraph;
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning directed PartitionOverlay test: ";
+    const int oneWaySize = 30;
+    std::vector<float> oneWayX;
+    std::vector<float> oneWayY;
+    std::vector<edge_t> oneWayEdges;
+    for (i = 0; i < oneWaySize; i++) {
+        for (j = 0; j < oneWaySize; j++) {
+            uint32_t here = (uint32_t)(i * oneWaySize + j);
+            oneWayX.push_back(i);
+            oneWayY.push_back(j);
+            if (i > 0) {
+                edge_t edge = {here, here - oneWaySize};
+                if (rand() % 2) {
+                    std::swap(edge.from, edge.to);
+                }
+                oneWayEdges.push_back(edge);
+            }
+            if (j > 0) {
+                edge_t edge = {here, here - 1};
+                if (rand() % 2) {
+                    std::swap(edge.from, edge.to);
+                }
+                oneWayEdges.push_back(edge);
+            }
+        }
+    }
+    Graph *oneWayGraph = new Graph();
+    rc = oneWayGraph->build(oneWayX.data(), oneWayY.data(), oneWaySize * oneWaySize,
+                            oneWayEdges.data(), oneWayEdges.size(), 1, 2);
+    assert(rc == SUCCESS);
+    PartitionOverlay *oneWayOverlay = new PartitionOverlay();
+    rc = oneWayOverlay->build(oneWayGraph, 3, 8);
+    assert(rc == SUCCESS);
+    std::shared_ptr<const GraphSnapshot> oneWaySnapshot = oneWayGraph->acquireSnapshot();
+    rc = oneWayOverlay->customize(oneWaySnapshot, 1);
+    assert(rc == SUCCESS);
+    for (i = 0; i < 60; i++) {
+        Node *from = oneWayGraph->getNodeAtIndex(rand() % (oneWaySize * oneWaySize));
+        Node *to = oneWayGraph->getNodeAtIndex(rand() % (oneWaySize * oneWaySize));
+        float expected = referenceDistance(from, to, oneWaySnapshot.get());
+        rc = oneWayOverlay->query(from, to, &overlayDistance);
+        if (expected == INFINITY) {
+            assert(rc == -1);
+        }
+        else {
+            assert(rc == SUCCESS);
+            assert(fabs(overlayDistance - expected) <= 1e-3 * expected + 1e-4);
+        }
+    }
+    delete oneWayOverlay;
+    delete oneWayGraph;
+    std::cout << "Test Passed" << std::endl;
+
+#ifdef ATLAS_TRACE
+    std::cout << "Beginning Tracer test: ";
+    char traceJsonPath[] = "/tmp/atlas_trace_XXXXXX";
+    char traceFoldedPath[] = "/tmp/atlas_folded_XXXXXX";
+    int traceFd = mkstemp(traceJsonPath);
+    assert(traceFd >= 0);
+    close(traceFd);
+    traceFd = mkstemp(traceFoldedPath);
+    assert(traceFd >= 0);
+    close(traceFd);
+    auto foldedTotal = [](const char *foldedPath) { // Sum of the weights of every call stack
+        char line[512];
+        unsigned long long total = 0;
+        FILE *foldedFile = fopen(foldedPath, "r");
+        assert(foldedFile != NULL);
+        while (fgets(line, sizeof(line), foldedFile) != NULL) {
+            const char *weight = strrchr(line, ' ');
+            assert(weight != NULL);
+            total += strtoull(weight + 1, NULL, 10);
+        }
+        fclose(foldedFile);
+        return total;
+    };
+    rc = Tracer::reset();
+    assert(rc == SUCCESS);
+    assert(Tracer::setSamplePeriod(0) == OUT_OF_BOUNDS);
+    rc = Tracer::setSamplePeriod(1); // Record every iteration
+    assert(rc == SUCCESS);
+    Graph *tracedGraph = new Graph();
+    rc = tracedGraph->build(lineX, lineY, 4, oneWay, 3, 0, 1);
+    assert(rc == SUCCESS);
+    rc = AStar(tracedGraph->getNodeAtIndex(0), tracedGraph->getNodeAtIndex(3), tracedGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    size_t everyIterationCount = Tracer::getEventCount();
+    assert(everyIterationCount > 0);
+    assert(Tracer::writeFoldedStacks(traceFoldedPath, 7) == OUT_OF_BOUNDS);
+    assert(Tracer::writeChromeTrace(NULL) == NULL_ARG);
+    rc = Tracer::writeChromeTrace(traceJsonPath);
+    assert(rc == SUCCESS);
+    rc = Tracer::writeFoldedStacks(traceFoldedPath, TRACE_TIME);
+    assert(rc == SUCCESS);
+    assert(foldedTotal(traceFoldedPath) > 0);
+    const char *tracePaths[2] = {traceJsonPath, traceFoldedPath};
+    const char *tracePhases[2] = {"\"AStar::heuristic\"", "AStar;AStar::queue "};
+    for (i = 0; i < 2; i++) {
+        char line[512];
+        int found = 0;
+        FILE *traceFile = fopen(tracePaths[i], "r");
+        assert(traceFile != NULL);
+        while (fgets(line, sizeof(line), traceFile) != NULL) {
+            if (strstr(line, tracePhases[i]) != NULL) {
+                found = 1;
+            }
+        }
+        fclose(traceFile);
+        assert(found == 1);
+    }
+    assert(Tracer::internName("AStar::queue") == Tracer::internName("AStar::queue"));
+    assert(Tracer::internName("AStar::queue") != Tracer::internName("AStar::expand"));
+    Tracer::reset();
+    rc = AStar(tracedGraph->getNodeAtIndex(0), tracedGraph->getNodeAtIndex(3)); // Legacy search, same phases
+    assert(rc == SUCCESS);
+    rc = Tracer::writeFoldedStacks(traceFoldedPath, TRACE_TIME);
+    assert(rc == SUCCESS);
+    const char *legacyPhases[3] = {"AStar;AStar::expand ", "AStar;AStar::heuristic ", "AStar;AStar::queue "};
+    for (i = 0; i < 3; i++) {
+        char line[512];
+        int found = 0;
+        FILE *traceFile = fopen(traceFoldedPath, "r");
+        assert(traceFile != NULL);
+        while (fgets(line, sizeof(line), traceFile) != NULL) {
+            if (strstr(line, legacyPhases[i]) != NULL) {
+                found = 1;
+            }
+        }
+        fclose(traceFile);
+        assert(found == 1);
+    }
+    Tracer::reset();
+    Tracer::setSamplePeriod(1000); // Only the first iteration is sampled
+    rc = AStar(tracedGraph->getNodeAtIndex(0), tracedGraph->getNodeAtIndex(3), tracedGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    assert(Tracer::getEventCount() > 1 && Tracer::getEventCount() < everyIterationCount);
+    Tracer::setSamplePeriod(TRACE_SAMPLE_PERIOD);
+    Tracer::setEventLimit(0);
+    size_t keptCount = Tracer::getEventCount();
+    rc = AStar(tracedGraph->getNodeAtIndex(0), tracedGraph->getNodeAtIndex(3), tracedGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    assert(Tracer::getEventCount() == keptCount);
+    assert(Tracer::getDroppedCount() > 0);
+    Tracer::setEventLimit(1000000);
+    std::cout << "Test Passed" << std::endl;
+
+    std::cout << "Beginning Tracer counter test: ";
+    assert(Tracer::enableCounters(3) == OUT_OF_BOUNDS);
+    const int counterModes[2] = {TRACE_COUNTERS_ON, TRACE_COUNTERS_READ}; // rdpmc, then read()
+    for (i = 0; i < 2; i++) {
+        Tracer::reset();
+        Tracer::setSamplePeriod(1);
+        rc = Tracer::enableCounters(counterModes[i]); // -1 where perf_event is not permitted
+        assert(rc == SUCCESS || rc == -1);
+        int countersOpen = (rc == SUCCESS);
+        for (j = 0; j < 20; j++) {
+            rc = AStar(tracedGraph->getNodeAtIndex(0), tracedGraph->getNodeAtIndex(3), tracedGraph->acquireSnapshot().get(), &path);
+            assert(rc == SUCCESS);
+        }
+        rc = Tracer::writeFoldedStacks(traceFoldedPath, TRACE_CYCLES);
+        assert(rc == SUCCESS);
+        if (countersOpen) {
+            assert(foldedTotal(traceFoldedPath) > 0);
+        }
+        else {
+            assert(foldedTotal(traceFoldedPath) == 0);
+        }
+    }
+    rc = Tracer::enableCounters(TRACE_COUNTERS_OFF);
+    assert(rc == SUCCESS);
+    Tracer::reset();
+    rc = AStar(tracedGraph->getNodeAtIndex(0), tracedGraph->getNodeAtIndex(3), tracedGraph->acquireSnapshot().get(), &path);
+    assert(rc == SUCCESS);
+    rc = Tracer::writeFoldedStacks(traceFoldedPath, TRACE_CYCLES);
+    assert(rc == SUCCESS);
+    assert(foldedTotal(traceFoldedPath) == 0);
+    Tracer::setSamplePeriod(TRACE_SAMPLE_PERIOD);
+    delete tracedGraph;
+    remove(traceJsonPath);
+    remove(traceFoldedPath);
+    std::cout << "Test Passed" << std::endl;
+#endif
     return 0;
 }